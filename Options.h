@@ -0,0 +1,132 @@
+#ifndef LSMTREE_OPTIONS_H
+#define LSMTREE_OPTIONS_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <memory>
+
+/*
+ * Tunables of a KVStore, passed down from KVStore to LSMTree, DiskTable and every SSTable written.
+ * Defaults reproduce behavior of a KVStore constructed without options.
+ */
+enum class FilterType {
+    Bloom, Xor
+};
+
+enum class CompactionStyle {
+    Leveled, Tiered
+};
+
+class RateLimiter;
+
+// Value of a key after operand is merged into it, existing_value is nullptr if key has no value.
+using MergeOperator=std::function<std::string(const std::string *existing_value, const std::string &operand)>;
+
+struct Options {
+    // Xor filter of an sstable takes about 30% less memory than a bloom filter of the same false positive rate
+    // and reads 3 slots per query, but can only be built from the whole key set, which is fine for sstables.
+    FilterType filter_type = FilterType::Bloom;
+    // Bloom filter of an sstable takes filter_bits_per_key * entries bits and filter_hashes hash functions,
+    // 0 hashes means the optimal count for filter_bits_per_key. Both are recorded in the filter.
+    // Xor filter takes 16 bits fingerprints if filter_bits_per_key allows, 8 bits otherwise.
+    double filter_bits_per_key = 10;
+    int filter_hashes = 4;
+    // Spread filter_bits_per_key * total entries over levels to minimize expected sstables probed by a miss
+    // (as in Monkey): each level gets false positive rate proportional to its size, so upper, smaller levels
+    // get more bits per key and the last level fewer.
+    bool filter_bits_per_level = false;
+
+    // Store a prefix bloom filter of keys in every sstable, so that scans skip sstables
+    // whose key range overlaps the queried range but which have no key inside it.
+    bool range_filter = false;
+
+    // Split restart index and filter of every sstable written into partitions of metadata_partition_restarts
+    // restart points. Only first key of every partition and offsets of filter partitions stay in memory,
+    // partitions are read on demand into a block cache of block_cache_bytes shared by all sstables,
+    // so memory taken by metadata no longer grows with data.
+    bool partitioned_metadata = false;
+    size_t metadata_partition_restarts = 64;
+    size_t block_cache_bytes = 8 * 1024 * 1024;
+    size_t block_cache_shards = 16;
+
+    // Total bytes of memtables, block cache, row cache and sstable metadata kept in memory, 0 for no limit.
+    // See MemoryBudget for how it's shared.
+    size_t memory_budget = 0;
+    double write_buffer_ratio = 0.5;
+
+    // Build a piecewise-linear learned index over restart keys of every sstable written,
+    // so that only its segments, instead of the whole restart index, stay in memory.
+    bool learned_index = false;
+    // Max distance between predicted and real position of a restart point.
+    size_t learned_index_epsilon = 4;
+
+    // Active memtable is flushed into an sstable of level 0 once it exceeds memtable_size bytes,
+    // sstables written by compaction are cut at sstable_size bytes. Both are 2 MB(not MiB) by default.
+    size_t memtable_size = 2 * 1000 * 1000;
+    size_t sstable_size = 2 * 1000 * 1000;
+    // Level 0 holds up to level0_limit sstables. Under leveled compaction level i holds level0_limit * level_factor ^ i
+    // sstables, under tiered compaction up to level_factor runs. A larger level_factor means fewer levels,
+    // it's at least 2.
+    size_t level0_limit = 2;
+    size_t level_factor = 2;
+    // Under leveled compaction, size levels by bytes instead of sstable counts, from the size of the last of
+    // max_levels levels up: each level targets 1 / level_factor of the one below, so most data is in the last level
+    // whatever the total. Level 0 is compacted into the highest level with a target of at least
+    // level0_limit * memtable_size bytes, levels above it stay empty until data grows.
+    bool dynamic_level_bytes = false;
+    size_t max_levels = 7;
+
+    // Leveled keeps one sorted run per level, for read-heavy tables. Tiered lets runs of similar size pile up
+    // in a level before merging them down, writing each key far fewer times, for ingest-heavy tables.
+    // See CompactionPolicy. Style of a db_dir should not change once written.
+    CompactionStyle compaction_style = CompactionStyle::Leveled;
+
+    // Under leveled compaction, an sstable more than this fraction of whose entries are tombstones is compacted
+    // on its own, down to the last level where its tombstones are dropped. 0 disables.
+    double tombstone_compaction_ratio = 0;
+
+    // Persist full memtables (flush and the compaction it triggers) on a worker thread owned by the LSMTree
+    // instead of on the writing thread.
+    bool background_flush = false;
+    // Writers wait when this many memtables are waiting to be persisted by the worker.
+    size_t max_immutable_memtables = 2;
+
+    // Threads serving KVStore::async_get and async_multi_get, created on first async read.
+    size_t async_read_threads = 4;
+
+    // Bytes of key -> value results of disk lookups cached by LSMTree, 0 disables row cache.
+    size_t row_cache_bytes = 0;
+    size_t row_cache_shards = 16;
+
+    // fsync every sstable and manifest record written, and directories they are renamed into, so that
+    // a persistent survives power loss once it returns. A process crash never loses or duplicates sstables
+    // regardless: sstables are renamed into place when complete and only take effect by a manifest record.
+    bool sync_files = false;
+
+    // Load header, filter and top level index of every sstable on this many threads when opening, 0 leaves them
+    // loaded on first access, so the first reads after a restart don't pay for it.
+    // warm_up_progress, if set, is called on the opening thread with sstables loaded so far and total.
+    size_t warm_up_threads = 0;
+    std::function<void(size_t, size_t)> warm_up_progress;
+
+    // Keep a cuckoo filter over keys of all sstables, so gets and dels of absent keys skip the walk through levels.
+    // About 2 bytes per key in memory, built by reading every sstable on startup if it wasn't saved on exit.
+    bool key_filter = false;
+
+    // Needed by merge. Operands are written blindly and folded into value of their key by gets, scans and
+    // compaction, a db_dir holding operands should always be opened with the same operator.
+    MergeOperator merge_operator;
+
+    // Bound bytes read and written by flushes and compaction, flushes first, see RateLimiter. With a limiter,
+    // compaction runs on a worker thread of its own, so that a throttled compaction never holds a flush back.
+    // May be shared by several KVStores, or partitions of one, to bound their I/O together. nullptr for no limit.
+    std::shared_ptr<RateLimiter> rate_limiter;
+    // With a limiter, a full memtable waits to be switched while level 0 has more than
+    // level0_stop_factor * level0_limit sstables, until compaction catches up, so that level 0 and the sstables
+    // every read probes there stay bounded. 0 never stops writes.
+    size_t level0_stop_factor = 4;
+};
+
+
+#endif //LSMTREE_OPTIONS_H
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <functional>
+#include <istream>
+#include <ostream>
 #include "Murmur.h"
 
 using std::vector;
@@ -23,6 +25,16 @@ public:
     auto find(const T &data);
 
     virtual ~BloomFilter();
+
+    // Bytes taken by the filter when serialized.
+    size_t size_bytes() const;
+
+    // Layout: m(8 bytes), n(8 bytes), seed(4 bytes), k(4 bytes), then bits packed into ceil(m/8) bytes.
+    template<typename U>
+    friend std::ostream &operator<<(std::ostream &os, const BloomFilter<U> &f);
+
+    template<typename U>
+    friend std::istream &operator>>(std::istream &is, BloomFilter<U> &f);
 };
 
 template<typename T>
@@ -54,3 +66,51 @@ auto BloomFilter<T>::find(const T &data) {
 template<typename T>
 BloomFilter<T>::~BloomFilter() {
 }
+
+template<typename T>
+size_t BloomFilter<T>::size_bytes() const {
+    return 8 + 8 + 4 + 4 + (_length + 7) / 8;
+}
+
+template<typename U>
+std::ostream &operator<<(std::ostream &os, const BloomFilter<U> &f) {
+    uint64_t m = f._length, n = f._max;
+    int32_t seed = f._seed, k = f._hashes.size();
+    os.write(reinterpret_cast<const char *>(&m), sizeof(m));
+    os.write(reinterpret_cast<const char *>(&n), sizeof(n));
+    os.write(reinterpret_cast<const char *>(&seed), sizeof(seed));
+    os.write(reinterpret_cast<const char *>(&k), sizeof(k));
+    for (size_t i = 0; i < m; i += 8) {
+        unsigned char byte = 0;
+        for (size_t j = 0; j < 8 && i + j < m; j++) {
+            byte |= f._bits[i + j] << j;
+        }
+        os.put(static_cast<char>(byte));
+    }
+    return os;
+}
+
+template<typename U>
+std::istream &operator>>(std::istream &is, BloomFilter<U> &f) {
+    uint64_t m = 0, n = 0;
+    int32_t seed = 0, k = 0;
+    is.read(reinterpret_cast<char *>(&m), sizeof(m));
+    is.read(reinterpret_cast<char *>(&n), sizeof(n));
+    is.read(reinterpret_cast<char *>(&seed), sizeof(seed));
+    is.read(reinterpret_cast<char *>(&k), sizeof(k));
+    f._length = m;
+    f._max = n;
+    f._seed = seed;
+    f._bits = vector<bool>(m);
+    f._hashes.clear();
+    for (int i = 0; i < k; i++) {
+        f._hashes.push_back(std::bind(MurmurHash64A, _1, _2, seed + i));
+    }
+    for (size_t i = 0; i < m; i += 8) {
+        auto byte = static_cast<unsigned char>(is.get());
+        for (size_t j = 0; j < 8 && i + j < m; j++) {
+            f._bits[i + j] = (byte >> j) & 1;
+        }
+    }
+    return is;
+}
@@ -0,0 +1,125 @@
+#include "CuckooFilter.h"
+#include "Murmur.h"
+
+CuckooFilter::CuckooFilter(size_t capacity) {
+    // Keep load factor under 0.9, where inserts of 4-way buckets rarely fail.
+    size_t buckets = 1;
+    while (buckets * SLOTS * 9 / 10 < capacity) {
+        buckets <<= 1;
+    }
+    table = std::vector<uint16_t>(buckets * SLOTS, 0);
+    mask = buckets - 1;
+}
+
+void CuckooFilter::hashOf(long long key, size_t &bucket, uint16_t &fingerprint) const {
+    auto h = MurmurHash64A(&key, sizeof(key), 0);
+    bucket = h & mask;
+    fingerprint = static_cast<uint16_t>(h >> 48);
+    if (fingerprint == 0) {
+        fingerprint = 1;
+    }
+}
+
+size_t CuckooFilter::altBucket(size_t bucket, uint16_t fingerprint) const {
+    // Involution: altBucket(altBucket(b, f), f) == b.
+    return (bucket ^ (fingerprint * 0x5bd1e995ULL)) & mask;
+}
+
+bool CuckooFilter::inBucket(size_t bucket, uint16_t fingerprint) const {
+    const auto *slots = &table[bucket * SLOTS];
+    for (size_t i = 0; i < SLOTS; i++) {
+        if (slots[i] == fingerprint) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::putIntoBucket(size_t bucket, uint16_t fingerprint) {
+    auto *slots = &table[bucket * SLOTS];
+    for (size_t i = 0; i < SLOTS; i++) {
+        if (slots[i] == 0) {
+            slots[i] = fingerprint;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CuckooFilter::add(long long key) {
+    if (has_victim) {
+        return false;
+    }
+    size_t bucket;
+    uint16_t fingerprint;
+    hashOf(key, bucket, fingerprint);
+    auto alt = altBucket(bucket, fingerprint);
+    if (putIntoBucket(bucket, fingerprint) || putIntoBucket(alt, fingerprint)) {
+        count++;
+        return true;
+    }
+    // Both buckets are full, kick fingerprints out to their alternative bucket.
+    bucket = (key & 1) ? alt : bucket;
+    for (int kick = 0; kick < MAX_KICKS; kick++) {
+        auto &slot = table[bucket * SLOTS + kick % SLOTS];
+        std::swap(slot, fingerprint);
+        bucket = altBucket(bucket, fingerprint);
+        if (putIntoBucket(bucket, fingerprint)) {
+            count++;
+            return true;
+        }
+    }
+    has_victim = true;
+    victim_bucket = bucket;
+    victim_fingerprint = fingerprint;
+    count++;
+    return false;
+}
+
+bool CuckooFilter::mightContain(long long key) const {
+    size_t bucket;
+    uint16_t fingerprint;
+    hashOf(key, bucket, fingerprint);
+    auto alt = altBucket(bucket, fingerprint);
+    if (inBucket(bucket, fingerprint) || inBucket(alt, fingerprint)) {
+        return true;
+    }
+    return has_victim && victim_fingerprint == fingerprint && (victim_bucket == bucket || victim_bucket == alt);
+}
+
+bool CuckooFilter::full() const {
+    return has_victim;
+}
+
+size_t CuckooFilter::size() const {
+    return count;
+}
+
+size_t CuckooFilter::capacity() const {
+    return table.size();
+}
+
+size_t CuckooFilter::size_bytes() const {
+    return table.size() * sizeof(uint16_t);
+}
+
+std::ostream &operator<<(std::ostream &os, const CuckooFilter &f) {
+    // Layout: slots(8 bytes), count(8 bytes), then fingerprints. A full filter is never written.
+    uint64_t slots = f.table.size(), count = f.count;
+    os.write(reinterpret_cast<const char *>(&slots), sizeof(slots));
+    os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    os.write(reinterpret_cast<const char *>(f.table.data()), slots * sizeof(uint16_t));
+    return os;
+}
+
+std::istream &operator>>(std::istream &is, CuckooFilter &f) {
+    uint64_t slots = 0, count = 0;
+    is.read(reinterpret_cast<char *>(&slots), sizeof(slots));
+    is.read(reinterpret_cast<char *>(&count), sizeof(count));
+    f.table = std::vector<uint16_t>(slots, 0);
+    is.read(reinterpret_cast<char *>(f.table.data()), slots * sizeof(uint16_t));
+    f.mask = slots / CuckooFilter::SLOTS - 1;
+    f.count = count;
+    f.has_victim = false;
+    return is;
+}
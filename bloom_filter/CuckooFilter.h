@@ -0,0 +1,56 @@
+#ifndef LSMTREE_CUCKOOFILTER_H
+#define LSMTREE_CUCKOOFILTER_H
+
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+/*
+ * Cuckoo filter of long long keys, 4 slots of 16 bits fingerprint per bucket.
+ * Unlike a bloom filter it can grow full: when add fails, the fingerprint evicted last is kept in a victim slot,
+ * so no key added before is lost, but the filter accepts nothing more and should be rebuilt with more capacity.
+ */
+class CuckooFilter {
+private:
+    static const size_t SLOTS = 4;
+    static const int MAX_KICKS = 500;
+
+    std::vector<uint16_t> table; // buckets * SLOTS fingerprints, 0 means an empty slot.
+    size_t mask; // buckets - 1, buckets is a power of 2.
+    size_t count = 0;
+    bool has_victim = false;
+    size_t victim_bucket = 0;
+    uint16_t victim_fingerprint = 0;
+
+    void hashOf(long long key, size_t &bucket, uint16_t &fingerprint) const;
+
+    size_t altBucket(size_t bucket, uint16_t fingerprint) const;
+
+    bool inBucket(size_t bucket, uint16_t fingerprint) const;
+
+    bool putIntoBucket(size_t bucket, uint16_t fingerprint);
+
+public:
+    explicit CuckooFilter(size_t capacity = 0);
+
+    // Return false if the filter is full, see above.
+    bool add(long long key);
+
+    bool mightContain(long long key) const;
+
+    bool full() const;
+
+    size_t size() const;
+
+    size_t capacity() const;
+
+    size_t size_bytes() const;
+
+    friend std::ostream &operator<<(std::ostream &os, const CuckooFilter &f);
+
+    friend std::istream &operator>>(std::istream &is, CuckooFilter &f);
+};
+
+
+#endif //LSMTREE_CUCKOOFILTER_H
@@ -0,0 +1,119 @@
+#include "RangeFilter.h"
+#include "Murmur.h"
+#include <cmath>
+#include <algorithm>
+
+uint64_t RangeFilter::toOrdered(long long key) {
+    // Flip sign bit so that unsigned order of prefixes agrees with signed order of keys.
+    return static_cast<uint64_t>(key) ^ (1ULL << 63);
+}
+
+RangeFilter::RangeFilter(const std::vector<long long> &keys, double bits_per_prefix) {
+    if (keys.empty()) {
+        return;
+    }
+    auto span = toOrdered(keys.back()) - toOrdered(keys.front());
+    auto gap = span / keys.size();
+    while (finest_shift < 63 && (1ULL << (finest_shift + 1)) <= gap) {
+        finest_shift++;
+    }
+    // Count distinct prefixes of every level to size the bits.
+    size_t prefixes = 0;
+    for (uint32_t level = 0; level < LEVELS; level++) {
+        auto shift = std::min(finest_shift + level * SHIFT_STEP, 63U);
+        for (size_t i = 0; i < keys.size(); i++) {
+            prefixes += i == 0 || (toOrdered(keys[i]) >> shift) != (toOrdered(keys[i - 1]) >> shift);
+        }
+    }
+    bits_per_prefix = std::max(bits_per_prefix, 1.0);
+    bits_count = std::max(static_cast<uint64_t>(bits_per_prefix * prefixes), static_cast<uint64_t>(64));
+    hashes = std::clamp(static_cast<int>(std::lround(bits_per_prefix * std::log(2))), 1, 30);
+    bits = std::vector<uint64_t>((bits_count + 63) / 64, 0);
+    for (uint32_t level = 0; level < LEVELS; level++) {
+        auto shift = std::min(finest_shift + level * SHIFT_STEP, 63U);
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i == 0 || (toOrdered(keys[i]) >> shift) != (toOrdered(keys[i - 1]) >> shift)) {
+                add(toOrdered(keys[i]) >> shift, shift);
+            }
+        }
+    }
+}
+
+void RangeFilter::add(uint64_t prefix, uint32_t shift) {
+    // Double hashing, shift is used as seed so that equal prefixes of different levels don't collide.
+    auto h = MurmurHash64A(&prefix, sizeof(prefix), shift);
+    auto h1 = h, h2 = (h >> 32) | 1;
+    for (uint32_t i = 0; i < hashes; i++) {
+        auto bit = (h1 + i * h2) % bits_count;
+        bits[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool RangeFilter::find(uint64_t prefix, uint32_t shift) const {
+    auto h = MurmurHash64A(&prefix, sizeof(prefix), shift);
+    auto h1 = h, h2 = (h >> 32) | 1;
+    for (uint32_t i = 0; i < hashes; i++) {
+        auto bit = (h1 + i * h2) % bits_count;
+        if (!(bits[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RangeFilter::mightContain(uint64_t lo, uint64_t hi, uint32_t level, int &probes) const {
+    auto shift = std::min(finest_shift + level * SHIFT_STEP, 63U);
+    auto first = lo >> shift, last = hi >> shift;
+    if (last - first >= static_cast<uint64_t>(MAX_PROBES - probes)) {
+        return true;
+    }
+    for (auto prefix = first;; prefix++) {
+        probes++;
+        if (find(prefix, shift)) {
+            if (level == 0) {
+                return true;
+            }
+            // Only the part of [lo, hi] covered by this prefix.
+            auto sub_lo = std::max<uint64_t>(lo, prefix << shift);
+            auto sub_hi = std::min<uint64_t>(hi, (prefix << shift) | ((1ULL << shift) - 1));
+            if (mightContain(sub_lo, sub_hi, level - 1, probes)) {
+                return true;
+            }
+        }
+        if (prefix == last) {
+            return false;
+        }
+    }
+}
+
+bool RangeFilter::mightContain(long long lo, long long hi) const {
+    if (bits_count == 0) {
+        return false; // Built from no keys.
+    }
+    if (lo > hi) {
+        return false;
+    }
+    int probes = 0;
+    return mightContain(toOrdered(lo), toOrdered(hi), LEVELS - 1, probes);
+}
+
+size_t RangeFilter::size_bytes() const {
+    return sizeof(bits_count) + sizeof(hashes) + sizeof(finest_shift) + bits.size() * sizeof(uint64_t);
+}
+
+std::ostream &operator<<(std::ostream &os, const RangeFilter &f) {
+    os.write(reinterpret_cast<const char *>(&f.bits_count), sizeof(f.bits_count));
+    os.write(reinterpret_cast<const char *>(&f.hashes), sizeof(f.hashes));
+    os.write(reinterpret_cast<const char *>(&f.finest_shift), sizeof(f.finest_shift));
+    os.write(reinterpret_cast<const char *>(f.bits.data()), f.bits.size() * sizeof(uint64_t));
+    return os;
+}
+
+std::istream &operator>>(std::istream &is, RangeFilter &f) {
+    is.read(reinterpret_cast<char *>(&f.bits_count), sizeof(f.bits_count));
+    is.read(reinterpret_cast<char *>(&f.hashes), sizeof(f.hashes));
+    is.read(reinterpret_cast<char *>(&f.finest_shift), sizeof(f.finest_shift));
+    f.bits = std::vector<uint64_t>((f.bits_count + 63) / 64, 0);
+    is.read(reinterpret_cast<char *>(f.bits.data()), f.bits.size() * sizeof(uint64_t));
+    return is;
+}
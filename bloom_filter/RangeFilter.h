@@ -0,0 +1,52 @@
+#ifndef LSMTREE_RANGEFILTER_H
+#define LSMTREE_RANGEFILTER_H
+
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+/*
+ * Prefix bloom filter answering whether a range [lo, hi] might contain any key of a static key set.
+ * Every key is added as its prefixes (high bits) at a few prefix lengths, finest one chosen so that a prefix covers
+ * about one key on average, each coarser one covering 16 times as many keys.
+ * A query walks down from coarsest prefixes covering [lo, hi] into finer ones only below prefixes present,
+ * and gives up (answers true) if too many prefixes should be probed, as for a range much wider than the key set's gaps.
+ */
+class RangeFilter {
+private:
+    static const uint32_t LEVELS = 4;
+    static const uint32_t SHIFT_STEP = 4;
+    static const int MAX_PROBES = 64;
+
+    std::vector<uint64_t> bits;
+    uint64_t bits_count = 0;
+    uint32_t hashes = 0;
+    uint32_t finest_shift = 0;
+
+    static uint64_t toOrdered(long long key);
+
+    void add(uint64_t prefix, uint32_t shift);
+
+    bool find(uint64_t prefix, uint32_t shift) const;
+
+    bool mightContain(uint64_t lo, uint64_t hi, uint32_t level, int &probes) const;
+
+public:
+    RangeFilter() = default;
+
+    // keys must be sorted.
+    RangeFilter(const std::vector<long long> &keys, double bits_per_prefix);
+
+    bool mightContain(long long lo, long long hi) const;
+
+    size_t size_bytes() const;
+
+    // Layout: bits count(8 bytes), hashes(4 bytes), finest shift(4 bytes), then ceil(bits count / 64) words.
+    friend std::ostream &operator<<(std::ostream &os, const RangeFilter &f);
+
+    friend std::istream &operator>>(std::istream &is, RangeFilter &f);
+};
+
+
+#endif //LSMTREE_RANGEFILTER_H
@@ -0,0 +1,170 @@
+#include "SSTableFilter.h"
+#include <cmath>
+#include <algorithm>
+
+BloomSSTableFilter::BloomSSTableFilter(BloomFilter<long long> &&bloom) : bloom(std::move(bloom)) {
+}
+
+bool BloomSSTableFilter::mightContain(long long key) const {
+    return bloom.find(key);
+}
+
+size_t BloomSSTableFilter::size_bytes() const {
+    return bloom.size_bytes();
+}
+
+SSTableFilter *BloomSSTableFilter::clone() const {
+    return new BloomSSTableFilter{*this};
+}
+
+void BloomSSTableFilter::write(std::ostream &os) const {
+    os << bloom;
+}
+
+SSTableFilter *SSTableFilter::build(const std::vector<long long> &keys, const Options &options) {
+    auto bits_per_key = std::max(options.filter_bits_per_key, 1.0);
+    if (options.filter_type == FilterType::Xor) {
+        // Xor filter of b bits fingerprint takes 1.23 * b bits per key, take 16 bits only if it fits in the budget.
+        if (bits_per_key >= 1.23 * 16) {
+            return new XorSSTableFilter<uint16_t>{XorFilter<uint16_t>{keys}};
+        }
+        return new XorSSTableFilter<uint8_t>{XorFilter<uint8_t>{keys}};
+    }
+    auto hashes = options.filter_hashes;
+    if (hashes <= 0) {
+        hashes = std::clamp(static_cast<int>(std::lround(bits_per_key * std::log(2))), 1, 30);
+    }
+    auto filter_bits = std::max(static_cast<size_t>(bits_per_key * keys.size()), static_cast<size_t>(1));
+    auto bloom = BloomFilter<long long>{filter_bits, keys.size(), 0, hashes};
+    for (auto key:keys) {
+        bloom.add(key);
+    }
+    return new BloomSSTableFilter{std::move(bloom)};
+}
+
+SSTableFilter *SSTableFilter::read(std::istream &is) {
+    uint64_t marker = 0;
+    is.read(reinterpret_cast<char *>(&marker), sizeof(marker));
+    if (marker != 0) {
+        is.seekg(-static_cast<std::streamoff>(sizeof(marker)), std::ios::cur);
+        auto bloom = BloomFilter<long long>{1, 1, 0};
+        is >> bloom;
+        return new BloomSSTableFilter{std::move(bloom)};
+    }
+    int32_t tag = 0;
+    is.read(reinterpret_cast<char *>(&tag), sizeof(tag));
+    if (tag == XorSSTableFilter<uint8_t>::TYPE_TAG) {
+        auto f = XorFilter<uint8_t>{};
+        is >> f;
+        return new XorSSTableFilter<uint8_t>{std::move(f)};
+    }
+    if (tag == XorSSTableFilter<uint16_t>::TYPE_TAG) {
+        auto f = XorFilter<uint16_t>{};
+        is >> f;
+        return new XorSSTableFilter<uint16_t>{std::move(f)};
+    }
+    if (tag == PartitionedSSTableFilter::TYPE_TAG) {
+        auto head = PartitionedSSTableFilter::readHead(is);
+        auto partitions = std::vector<SSTableFilter *>{};
+        for (size_t p = 0; p < head.first_keys.size(); p++) {
+            partitions.push_back(SSTableFilter::read(is));
+        }
+        return new PartitionedSSTableFilter{std::move(head), std::move(partitions)};
+    }
+    throw UnknownFilterTypeException();
+}
+
+size_t PartitionedSSTableFilter::Head::partitionOf(long long key) const {
+    auto p = std::upper_bound(first_keys.begin(), first_keys.end(), key);
+    if (p == first_keys.begin()) {
+        return first_keys.size();
+    }
+    return std::distance(first_keys.begin(), p) - 1;
+}
+
+size_t PartitionedSSTableFilter::Head::size_bytes() const {
+    return sizeof(uint64_t) + sizeof(int32_t) + 2 * sizeof(uint64_t) + first_keys.size() * sizeof(long long) +
+           offsets.size() * sizeof(uint64_t);
+}
+
+PartitionedSSTableFilter::PartitionedSSTableFilter(Head &&head, std::vector<SSTableFilter *> &&partitions) :
+        head(std::move(head)), partitions(std::move(partitions)) {
+}
+
+PartitionedSSTableFilter::PartitionedSSTableFilter(const std::vector<long long> &keys, size_t keys_per_partition,
+                                                   size_t restarts_per_partition, const Options &options) {
+    head.restarts_per_partition = restarts_per_partition;
+    for (size_t first = 0; first < keys.size(); first += keys_per_partition) {
+        auto last = std::min(first + keys_per_partition, keys.size());
+        head.first_keys.push_back(keys[first]);
+        partitions.push_back(SSTableFilter::build(std::vector<long long>(keys.begin() + first, keys.begin() + last),
+                                                  options));
+    }
+    // Offsets are only known once every partition is built.
+    head.offsets.resize(partitions.size() + 1);
+    head.offsets[0] = sizeof(uint64_t) + sizeof(int32_t) + 2 * sizeof(uint64_t) +
+                      head.first_keys.size() * sizeof(long long) + head.offsets.size() * sizeof(uint64_t);
+    for (size_t p = 0; p < partitions.size(); p++) {
+        head.offsets[p + 1] = head.offsets[p] + partitions[p]->size_bytes();
+    }
+}
+
+PartitionedSSTableFilter::PartitionedSSTableFilter(const PartitionedSSTableFilter &rhs) : head(rhs.head) {
+    for (auto *p:rhs.partitions) {
+        partitions.push_back(p->clone());
+    }
+}
+
+PartitionedSSTableFilter::~PartitionedSSTableFilter() {
+    for (auto *p:partitions) {
+        delete p;
+    }
+}
+
+const PartitionedSSTableFilter::Head &PartitionedSSTableFilter::getHead() const {
+    return head;
+}
+
+const SSTableFilter *PartitionedSSTableFilter::partition(size_t p) const {
+    return partitions[p];
+}
+
+bool PartitionedSSTableFilter::mightContain(long long key) const {
+    auto p = head.partitionOf(key);
+    return p < partitions.size() && partitions[p]->mightContain(key);
+}
+
+size_t PartitionedSSTableFilter::size_bytes() const {
+    return head.offsets.back();
+}
+
+SSTableFilter *PartitionedSSTableFilter::clone() const {
+    return new PartitionedSSTableFilter{*this};
+}
+
+void PartitionedSSTableFilter::write(std::ostream &os) const {
+    uint64_t marker = 0, count = partitions.size(), restarts = head.restarts_per_partition;
+    int32_t tag = TYPE_TAG;
+    os.write(reinterpret_cast<const char *>(&marker), sizeof(marker));
+    os.write(reinterpret_cast<const char *>(&tag), sizeof(tag));
+    os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    os.write(reinterpret_cast<const char *>(&restarts), sizeof(restarts));
+    os.write(reinterpret_cast<const char *>(head.first_keys.data()), count * sizeof(long long));
+    os.write(reinterpret_cast<const char *>(head.offsets.data()), (count + 1) * sizeof(uint64_t));
+    for (auto *p:partitions) {
+        p->write(os);
+    }
+}
+
+PartitionedSSTableFilter::Head PartitionedSSTableFilter::readHead(std::istream &is) {
+    uint64_t count = 0, restarts = 0;
+    is.read(reinterpret_cast<char *>(&count), sizeof(count));
+    is.read(reinterpret_cast<char *>(&restarts), sizeof(restarts));
+    auto head = Head{};
+    head.restarts_per_partition = restarts;
+    head.first_keys.resize(count);
+    head.offsets.resize(count + 1);
+    is.read(reinterpret_cast<char *>(head.first_keys.data()), count * sizeof(long long));
+    is.read(reinterpret_cast<char *>(head.offsets.data()), (count + 1) * sizeof(uint64_t));
+    return head;
+}
@@ -0,0 +1,143 @@
+#ifndef LSMTREE_SSTABLEFILTER_H
+#define LSMTREE_SSTABLEFILTER_H
+
+#include "BloomFilter.h"
+#include "XorFilter.h"
+#include "../Options.h"
+#include <vector>
+#include <istream>
+#include <ostream>
+
+class UnknownFilterTypeException : public std::exception {
+};
+
+/*
+ * Filter of keys of an sstable, answering "definitely not in sstable" for most absent keys.
+ * On disk a filter block starts with 8 bytes of bit count of a bloom filter, followed by the rest of BloomFilter layout,
+ * or with 8 zero bytes (a bloom filter has at least 1 bit) and a 4 bytes type tag of any other filter, then its layout.
+ */
+class SSTableFilter {
+public:
+    virtual ~SSTableFilter() = default;
+
+    virtual bool mightContain(long long key) const = 0;
+
+    // Bytes of the filter block.
+    virtual size_t size_bytes() const = 0;
+
+    virtual SSTableFilter *clone() const = 0;
+
+    virtual void write(std::ostream &os) const = 0;
+
+    // keys are sorted and distinct. Caller takes ownership.
+    static SSTableFilter *build(const std::vector<long long> &keys, const Options &options);
+
+    // Caller takes ownership.
+    static SSTableFilter *read(std::istream &is);
+};
+
+class BloomSSTableFilter : public SSTableFilter {
+private:
+    mutable BloomFilter<long long> bloom; // BloomFilter::find is not const.
+
+public:
+    explicit BloomSSTableFilter(BloomFilter<long long> &&bloom);
+
+    bool mightContain(long long key) const override;
+
+    size_t size_bytes() const override;
+
+    SSTableFilter *clone() const override;
+
+    void write(std::ostream &os) const override;
+};
+
+template<typename Fingerprint>
+class XorSSTableFilter : public SSTableFilter {
+private:
+    XorFilter<Fingerprint> xorFilter;
+
+public:
+    static const int32_t TYPE_TAG = sizeof(Fingerprint);
+
+    explicit XorSSTableFilter(XorFilter<Fingerprint> &&f) : xorFilter(std::move(f)) {
+    }
+
+    bool mightContain(long long key) const override {
+        return xorFilter.mightContain(key);
+    }
+
+    size_t size_bytes() const override {
+        return sizeof(uint64_t) + sizeof(int32_t) + xorFilter.size_bytes();
+    }
+
+    SSTableFilter *clone() const override {
+        return new XorSSTableFilter{*this};
+    }
+
+    void write(std::ostream &os) const override {
+        uint64_t marker = 0;
+        int32_t tag = TYPE_TAG;
+        os.write(reinterpret_cast<const char *>(&marker), sizeof(marker));
+        os.write(reinterpret_cast<const char *>(&tag), sizeof(tag));
+        os << xorFilter;
+    }
+};
+
+
+/*
+ * Filter split into partitions of keys of restart_count consecutive restart points, so that a reader keeps only
+ * first key and offset of every partition in memory and loads the partition of a key on demand.
+ * Layout: 8 zero bytes, type tag, partitions count(8 bytes), restarts per partition(8 bytes),
+ * first key of every partition, count + 1 offsets of partitions relative to the beginning of the block,
+ * then filter block of every partition.
+ */
+class PartitionedSSTableFilter : public SSTableFilter {
+public:
+    static const int32_t TYPE_TAG = 0x100;
+
+    // What stays in memory: the top level index of partitions.
+    struct Head {
+        size_t restarts_per_partition = 0;
+        std::vector<long long> first_keys;
+        std::vector<uint64_t> offsets;
+
+        // Partition which key would be in, first_keys.size() if key is less than first key.
+        size_t partitionOf(long long key) const;
+
+        size_t size_bytes() const;
+    };
+
+private:
+    Head head;
+    std::vector<SSTableFilter *> partitions;
+
+public:
+    PartitionedSSTableFilter(Head &&head, std::vector<SSTableFilter *> &&partitions);
+
+    // keys_per_partition keys in each partition, built by SSTableFilter::build with options.
+    PartitionedSSTableFilter(const std::vector<long long> &keys, size_t keys_per_partition,
+                             size_t restarts_per_partition, const Options &options);
+
+    PartitionedSSTableFilter(const PartitionedSSTableFilter &rhs);
+
+    ~PartitionedSSTableFilter() override;
+
+    const Head &getHead() const;
+
+    const SSTableFilter *partition(size_t p) const;
+
+    bool mightContain(long long key) const override;
+
+    size_t size_bytes() const override;
+
+    SSTableFilter *clone() const override;
+
+    void write(std::ostream &os) const override;
+
+    // Read the rest of head after marker and type tag.
+    static Head readHead(std::istream &is);
+};
+
+
+#endif //LSMTREE_SSTABLEFILTER_H
@@ -0,0 +1,163 @@
+#ifndef LSMTREE_XORFILTER_H
+#define LSMTREE_XORFILTER_H
+
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <algorithm>
+#include <exception>
+#include "Murmur.h"
+
+// Seeds tried before giving up, peeling fails for one with probability well below 1%.
+const int XOR_FILTER_MAX_SEEDS = 64;
+
+class XorFilterBuildException : public std::exception {
+};
+
+/*
+ * Xor filter (Graf and Lemire) over a static set of long long keys, built once and never added to.
+ * A key maps to one slot in each of three blocks, and the xor of fingerprints in these slots equals fingerprint of the key.
+ * Fingerprint is Fingerprint wide (uint8_t or uint16_t), false positive rate is 2^-bits,
+ * taking about 1.23 * bits bits per key. A query reads exactly 3 slots.
+ */
+template<typename Fingerprint>
+class XorFilter {
+private:
+    uint64_t seed = 0;
+    size_t block_length = 0;
+    std::vector<Fingerprint> fingerprints;
+
+    uint64_t hashOf(long long key) const {
+        return MurmurHash64A(&key, sizeof(key), static_cast<unsigned int>(seed));
+    }
+
+    static Fingerprint fingerprintOf(uint64_t h) {
+        return static_cast<Fingerprint>(h ^ (h >> 32));
+    }
+
+    static size_t reduce(uint32_t h, size_t n) {
+        // Map h into [0, n) without modulo.
+        return static_cast<size_t>((static_cast<uint64_t>(h) * n) >> 32);
+    }
+
+    size_t slotOf(uint64_t h, int i) const {
+        auto r = static_cast<uint32_t>(i == 0 ? h : (h << (21 * i)) | (h >> (64 - 21 * i)));
+        return reduce(r, block_length) + i * block_length;
+    }
+
+    bool tryBuild(const std::vector<long long> &keys);
+
+public:
+    XorFilter() = default;
+
+    // Duplicate keys are taken once. Throw XorFilterBuildException if no seed tried builds the filter.
+    explicit XorFilter(std::vector<long long> keys);
+
+    bool mightContain(long long key) const {
+        auto h = hashOf(key);
+        return fingerprintOf(h) == (fingerprints[slotOf(h, 0)] ^ fingerprints[slotOf(h, 1)] ^
+                                    fingerprints[slotOf(h, 2)]);
+    }
+
+    size_t size_bytes() const {
+        return sizeof(seed) + sizeof(uint64_t) + fingerprints.size() * sizeof(Fingerprint);
+    }
+
+    // Layout: seed(8 bytes), block length(8 bytes), then 3 * block length fingerprints.
+    template<typename F>
+    friend std::ostream &operator<<(std::ostream &os, const XorFilter<F> &f);
+
+    template<typename F>
+    friend std::istream &operator>>(std::istream &is, XorFilter<F> &f);
+};
+
+template<typename Fingerprint>
+XorFilter<Fingerprint>::XorFilter(std::vector<long long> keys) {
+    // A key added twice is never the only one in its slots, so it could never be peeled.
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    block_length = (static_cast<size_t>(1.23 * keys.size()) + 32) / 3;
+    fingerprints = std::vector<Fingerprint>(3 * block_length, 0);
+    // Peeling fails with a small probability for a given seed, retry with another one.
+    while (!tryBuild(keys)) {
+        if (++seed == XOR_FILTER_MAX_SEEDS) {
+            throw XorFilterBuildException();
+        }
+    }
+}
+
+template<typename Fingerprint>
+bool XorFilter<Fingerprint>::tryBuild(const std::vector<long long> &keys) {
+    auto capacity = fingerprints.size();
+    auto counts = std::vector<uint32_t>(capacity, 0);
+    auto xor_hashes = std::vector<uint64_t>(capacity, 0);
+    for (auto key:keys) {
+        auto h = hashOf(key);
+        for (int i = 0; i < 3; i++) {
+            auto slot = slotOf(h, i);
+            counts[slot]++;
+            xor_hashes[slot] ^= h;
+        }
+    }
+    // Repeatedly take out a key which is the only one in some slot, that slot is then free to fix its fingerprint.
+    auto queue = std::vector<size_t>{};
+    for (size_t slot = 0; slot < capacity; slot++) {
+        if (counts[slot] == 1) {
+            queue.push_back(slot);
+        }
+    }
+    auto stack = std::vector<std::pair<uint64_t, size_t>>{};
+    stack.reserve(keys.size());
+    while (!queue.empty()) {
+        auto slot = queue.back();
+        queue.pop_back();
+        if (counts[slot] != 1) {
+            continue;
+        }
+        auto h = xor_hashes[slot];
+        stack.emplace_back(h, slot);
+        for (int i = 0; i < 3; i++) {
+            auto other = slotOf(h, i);
+            counts[other]--;
+            xor_hashes[other] ^= h;
+            if (counts[other] == 1) {
+                queue.push_back(other);
+            }
+        }
+    }
+    if (stack.size() != keys.size()) {
+        return false;
+    }
+    std::fill(fingerprints.begin(), fingerprints.end(), 0);
+    for (auto p = stack.rbegin(); p != stack.rend(); p++) {
+        auto[h, slot] = *p;
+        fingerprints[slot] = 0;
+        fingerprints[slot] = fingerprintOf(h) ^ fingerprints[slotOf(h, 0)] ^ fingerprints[slotOf(h, 1)] ^
+                             fingerprints[slotOf(h, 2)];
+    }
+    return true;
+}
+
+template<typename F>
+std::ostream &operator<<(std::ostream &os, const XorFilter<F> &f) {
+    uint64_t block_length = f.block_length;
+    os.write(reinterpret_cast<const char *>(&f.seed), sizeof(f.seed));
+    os.write(reinterpret_cast<const char *>(&block_length), sizeof(block_length));
+    os.write(reinterpret_cast<const char *>(f.fingerprints.data()), f.fingerprints.size() * sizeof(F));
+    return os;
+}
+
+template<typename F>
+std::istream &operator>>(std::istream &is, XorFilter<F> &f) {
+    uint64_t block_length = 0;
+    is.read(reinterpret_cast<char *>(&f.seed), sizeof(f.seed));
+    is.read(reinterpret_cast<char *>(&block_length), sizeof(block_length));
+    f.block_length = block_length;
+    f.fingerprints = std::vector<F>(3 * block_length, 0);
+    is.read(reinterpret_cast<char *>(f.fingerprints.data()), f.fingerprints.size() * sizeof(F));
+    return is;
+}
+
+
+#endif //LSMTREE_XORFILTER_H
@@ -0,0 +1,72 @@
+#include "BlockCache.h"
+
+BlockCache::BlockCache(size_t capacity, size_t shards_count) : shards(shards_count == 0 ? 1 : shards_count) {
+    shard_capacity = capacity / shards.size();
+}
+
+BlockCache::Shard &BlockCache::shardOf(uint64_t owner, uint64_t offset) {
+    return shards[KeyHash{}({owner, offset}) % shards.size()];
+}
+
+void BlockCache::evict(Shard &shard, size_t capacity) {
+    while (shard.usage > capacity && !shard.lru.empty()) {
+        auto &victim = shard.lru.back();
+        shard.usage -= victim.charge;
+        shard.map.erase({victim.owner, victim.offset});
+        shard.lru.pop_back();
+    }
+}
+
+BlockCache::Block BlockCache::lookup(uint64_t owner, uint64_t offset) {
+    auto &shard = shardOf(owner, offset);
+    std::lock_guard lock{shard.mutex};
+    auto p = shard.map.find({owner, offset});
+    if (p == shard.map.end()) {
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, p->second);
+    return p->second->block;
+}
+
+void BlockCache::insert(uint64_t owner, uint64_t offset, Block block, size_t charge) {
+    auto capacity = shard_capacity.load();
+    if (charge > capacity) {
+        return;
+    }
+    auto &shard = shardOf(owner, offset);
+    std::lock_guard lock{shard.mutex};
+    if (shard.map.count({owner, offset}) != 0) {
+        // Another reader loaded the same block first.
+        return;
+    }
+    shard.lru.push_front(Entry{owner, offset, std::move(block), charge});
+    shard.map[{owner, offset}] = shard.lru.begin();
+    shard.usage += charge;
+    evict(shard, capacity);
+}
+
+size_t BlockCache::usage() {
+    size_t total = 0;
+    for (auto &shard:shards) {
+        std::lock_guard lock{shard.mutex};
+        total += shard.usage;
+    }
+    return total;
+}
+
+size_t BlockCache::capacity() const {
+    return shard_capacity.load() * shards.size();
+}
+
+void BlockCache::setCapacity(size_t capacity) {
+    shard_capacity = capacity / shards.size();
+    for (auto &shard:shards) {
+        std::lock_guard lock{shard.mutex};
+        evict(shard, shard_capacity.load());
+    }
+}
+
+uint64_t BlockCache::newOwner() {
+    static std::atomic<uint64_t> next_owner{1};
+    return next_owner++;
+}
@@ -0,0 +1,68 @@
+#ifndef LSMTREE_BLOCKCACHE_H
+#define LSMTREE_BLOCKCACHE_H
+
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * LRU cache of blocks read from sstables, shared by all sstables of a DiskTable and bounded by capacity bytes.
+ * A block is identified by owner, a number unique to every sstable opened in this process, and its offset in file.
+ * A block evicted while a reader still holds it stays alive until that reader releases it.
+ */
+class BlockCache {
+public:
+    using Block=std::shared_ptr<const void>;
+
+private:
+    struct Entry {
+        uint64_t owner;
+        uint64_t offset;
+        Block block;
+        size_t charge;
+    };
+
+    struct KeyHash {
+        size_t operator()(const std::pair<uint64_t, uint64_t> &k) const {
+            return std::hash<uint64_t>{}(k.first * 0x9e3779b97f4a7c15ULL ^ k.second);
+        }
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> lru; // Most recently used first.
+        std::unordered_map<std::pair<uint64_t, uint64_t>, std::list<Entry>::iterator, KeyHash> map;
+        size_t usage = 0;
+    };
+
+    std::vector<Shard> shards;
+    std::atomic<size_t> shard_capacity;
+
+    Shard &shardOf(uint64_t owner, uint64_t offset);
+
+    static void evict(Shard &shard, size_t capacity);
+
+public:
+    BlockCache(size_t capacity, size_t shards_count);
+
+    // nullptr on miss.
+    Block lookup(uint64_t owner, uint64_t offset);
+
+    void insert(uint64_t owner, uint64_t offset, Block block, size_t charge);
+
+    size_t usage();
+
+    size_t capacity() const;
+
+    // Evict least recently used blocks at once if usage is over new capacity.
+    void setCapacity(size_t capacity);
+
+    static uint64_t newOwner();
+};
+
+
+#endif //LSMTREE_BLOCKCACHE_H
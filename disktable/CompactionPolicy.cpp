@@ -0,0 +1,254 @@
+#include "CompactionPolicy.h"
+#include <climits>
+
+CompactionPolicy *CompactionPolicy::create(const Options &options) {
+    if (options.compaction_style == CompactionStyle::Tiered) {
+        return new TieredCompaction{options};
+    }
+    return new LeveledCompaction{options};
+}
+
+LeveledCompaction::LeveledCompaction(const Options &options) : level0_limit(options.level0_limit),
+                                                               level_factor(options.level_factor),
+                                                               dynamic_level_bytes(options.dynamic_level_bytes),
+                                                               max_levels(std::max<size_t>(options.max_levels, 2)),
+                                                               base_bytes(options.level0_limit *
+                                                                          options.memtable_size),
+                                                               tombstone_compaction_ratio(
+                                                                       options.tombstone_compaction_ratio) {
+}
+
+size_t LeveledCompaction::levelLimit(size_t level) const {
+    auto limit = level0_limit;
+    for (size_t i = 0; i < level; i++) {
+        limit *= level_factor;
+    }
+    return limit;
+}
+
+DiskTable::DiskTableNodePtr LeveledCompaction::pickFile(DiskTable::DiskViewLevel &level, size_t level_no) {
+    if (compact_cursor.size() <= level_no) {
+        compact_cursor.resize(level_no + 1, LLONG_MIN);
+    }
+    // First sstable after cursor, or first one of level if cursor is past the last.
+    auto picked = level.end(), first = level.end();
+    for (auto node = level.begin(); node != level.end(); node++) {
+        auto key_min = (*node)->keyRange().first;
+        if (first == level.end() || key_min < (*first)->keyRange().first) {
+            first = node;
+        }
+        if (key_min > compact_cursor[level_no] &&
+            (picked == level.end() || key_min < (*picked)->keyRange().first)) {
+            picked = node;
+        }
+    }
+    if (picked == level.end()) {
+        picked = first;
+    }
+    auto node = *picked;
+    compact_cursor[level_no] = node->keyRange().second;
+    level.erase(picked);
+    return node;
+}
+
+size_t LeveledCompaction::bytesOf(const DiskTable::DiskViewLevel &level) {
+    size_t bytes = 0;
+    for (const auto &node:level) {
+        bytes += node->fileSize();
+    }
+    return bytes;
+}
+
+std::vector<size_t> LeveledCompaction::levelTargets(const DiskTable::DiskView &view, size_t &base_level) const {
+    auto last = view.size() - 1;
+    auto targets = std::vector<size_t>(view.size(), 0);
+    targets[last] = std::max(bytesOf(view[last]), base_bytes);
+    base_level = last;
+    while (base_level > 1 && targets[base_level] / level_factor >= base_bytes) {
+        targets[base_level - 1] = targets[base_level] / level_factor;
+        base_level--;
+    }
+    return targets;
+}
+
+bool LeveledCompaction::pickByBytes(DiskTable::DiskView &view, Compaction &compaction) {
+    if (view.size() < max_levels) {
+        view.resize(max_levels);
+    }
+    size_t base_level = 0;
+    auto targets = levelTargets(view, base_level);
+    compaction.merge_next_level = true;
+    compaction.inputs.clear();
+    if (view[0].size() > level0_limit) {
+        compaction.level = 0;
+        compaction.output_level = base_level;
+        compaction.inputs.swap(view[0]);
+        compaction.inputs.reverse();
+        return true;
+    }
+    // Last level is never compacted, its size decides targets of others.
+    for (size_t level = 1; level + 1 < view.size(); level++) {
+        if (bytesOf(view[level]) > targets[level]) {
+            compaction.level = level;
+            compaction.output_level = level + 1;
+            compaction.inputs.push_back(pickFile(view[level], level));
+            return true;
+        }
+    }
+    return pickTombstones(view, compaction);
+}
+
+bool LeveledCompaction::pickTombstones(DiskTable::DiskView &view, Compaction &compaction) {
+    if (tombstone_compaction_ratio <= 0) {
+        return false;
+    }
+    for (size_t level = 1; level < view.size(); level++) {
+        for (auto node = view[level].begin(); node != view[level].end(); node++) {
+            if ((*node)->entriesCount() == 0 ||
+                (*node)->tombstonesCount() <= tombstone_compaction_ratio * (*node)->entriesCount()) {
+                continue;
+            }
+            compaction.level = level;
+            compaction.output_level = level + 1 < view.size() ? level + 1 : level;
+            compaction.merge_next_level = true;
+            compaction.inputs.clear();
+            compaction.inputs.push_back(*node);
+            view[level].erase(node);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool LeveledCompaction::pick(DiskTable::DiskView &view, Compaction &compaction) {
+    if (dynamic_level_bytes) {
+        return pickByBytes(view, compaction);
+    }
+    // Compaction of a level may push next level over its limit, which is picked in next call.
+    for (size_t level = 0; level < view.size(); level++) {
+        if (view[level].size() <= levelLimit(level)) {
+            continue;
+        }
+        compaction.level = level;
+        compaction.output_level = level + 1;
+        compaction.merge_next_level = true;
+        compaction.inputs.clear();
+        if (level == 0) {
+            // Sstables of level 0 overlap each other, they all go down together.
+            compaction.inputs.swap(view[0]);
+            compaction.inputs.reverse();
+        } else {
+            compaction.inputs.push_back(pickFile(view[level], level));
+        }
+        return true;
+    }
+    return pickTombstones(view, compaction);
+}
+
+size_t LeveledCompaction::compactionDebt(const DiskTable::DiskView &view) const {
+    if (view.empty()) {
+        return 0;
+    }
+    size_t debt = view[0].size() > level0_limit ? bytesOf(view[0]) : 0;
+    if (dynamic_level_bytes) {
+        auto levels = view;
+        levels.resize(std::max(levels.size(), max_levels)); // As pickByBytes does.
+        size_t base_level = 0;
+        auto targets = levelTargets(levels, base_level);
+        for (size_t level = 1; level + 1 < levels.size(); level++) {
+            auto bytes = bytesOf(levels[level]);
+            debt += bytes > targets[level] ? bytes - targets[level] : 0;
+        }
+        return debt;
+    }
+    for (size_t level = 1; level < view.size(); level++) {
+        auto count = view[level].size(), limit = levelLimit(level);
+        if (count > limit) {
+            debt += bytesOf(view[level]) / count * (count - limit);
+        }
+    }
+    return debt;
+}
+
+TieredCompaction::TieredCompaction(const Options &options) : level0_limit(options.level0_limit),
+                                                             level_factor(options.level_factor) {
+}
+
+std::vector<TieredCompaction::Tier> TieredCompaction::runsOf(const DiskTable::DiskViewLevel &level) {
+    auto runs = std::vector<Tier>{};
+    for (auto node = level.begin(); node != level.end(); node++) {
+        auto overlapping = !runs.empty() && std::any_of(runs.back().begin, node,
+                                                        [&node](const DiskTable::DiskTableNodePtr &n) {
+                                                            return n->intersect(**node);
+                                                        });
+        if (runs.empty() || overlapping) {
+            runs.push_back(Tier{node, node, 1, 0});
+        }
+        runs.back().end = std::next(node);
+        runs.back().bytes += (*node)->fileSize();
+    }
+    return runs;
+}
+
+std::vector<TieredCompaction::Tier> TieredCompaction::tiersOf(const DiskTable::DiskViewLevel &level) {
+    auto tiers = std::vector<Tier>{};
+    for (const auto &run:runsOf(level)) {
+        if (!tiers.empty()) {
+            auto &tier = tiers.back();
+            auto average = tier.bytes / tier.runs;
+            if (run.bytes <= average * TIERED_RUN_SIZE_RATIO && average <= run.bytes * TIERED_RUN_SIZE_RATIO) {
+                tier.end = run.end;
+                tier.runs++;
+                tier.bytes += run.bytes;
+                continue;
+            }
+        }
+        tiers.push_back(run);
+    }
+    return tiers;
+}
+
+bool TieredCompaction::pick(DiskTable::DiskView &view, Compaction &compaction) {
+    compaction.merge_next_level = false;
+    if (view[0].size() > level0_limit) {
+        compaction.level = 0;
+        compaction.output_level = 1;
+        compaction.inputs.clear();
+        compaction.inputs.swap(view[0]);
+        compaction.inputs.reverse();
+        return true;
+    }
+    for (size_t level = 1; level < view.size(); level++) {
+        auto tiers = tiersOf(view[level]);
+        if (tiers.empty()) {
+            continue;
+        }
+        // Sstables written take the newest numbers, which order them in their level when manifest is replayed:
+        // the oldest tier may go below every run left in level, the newest one is rewritten at the end of it.
+        auto tier = tiers.front();
+        compaction.output_level = level + 1;
+        if (tier.runs <= level_factor) {
+            tier = tiers.back();
+            compaction.output_level = level;
+        }
+        if (tier.runs <= level_factor) {
+            continue;
+        }
+        compaction.level = level;
+        compaction.inputs.clear();
+        compaction.inputs.splice(compaction.inputs.begin(), view[level], tier.begin, tier.end);
+        compaction.inputs.reverse();
+        return true;
+    }
+    return false;
+}
+
+size_t TieredCompaction::compactionDebt(const DiskTable::DiskView &view) const {
+    size_t debt = view.empty() || view[0].size() <= level0_limit ? 0 : LeveledCompaction::bytesOf(view[0]);
+    for (size_t level = 1; level < view.size(); level++) {
+        for (const auto &tier:tiersOf(view[level])) {
+            debt += tier.runs > level_factor ? tier.bytes : 0;
+        }
+    }
+    return debt;
+}
@@ -0,0 +1,117 @@
+#ifndef LSMTREE_COMPACTIONPOLICY_H
+#define LSMTREE_COMPACTIONPOLICY_H
+
+#include "DiskTable.h"
+
+// Sstables merged by one compaction, taken from level, result goes into output_level.
+struct Compaction {
+    size_t level;
+    size_t output_level;
+    DiskTable::DiskViewLevel inputs; // Later sstables first, they take precedence in merge.
+    // Also merge sstables of output level overlapping inputs, so that output level stays a single sorted run.
+    bool merge_next_level;
+};
+
+/*
+ * Decides which sstables DiskTable::persistent merges after every flush, until none needs to.
+ * A policy is owned by one DiskTable and only called by its writer.
+ * Style of a db_dir should not change once written: a level written by one style may break assumptions of another.
+ */
+class CompactionPolicy {
+public:
+    virtual ~CompactionPolicy() = default;
+
+    // Take inputs of next compaction out of view, return false if view needs no compaction.
+    virtual bool pick(DiskTable::DiskView &view, Compaction &compaction) = 0;
+
+    // Estimate of bytes view has over limits of its levels, which compaction has yet to move down.
+    virtual size_t compactionDebt(const DiskTable::DiskView &view) const = 0;
+
+    // Policy of options.compaction_style.
+    static CompactionPolicy *create(const Options &options);
+};
+
+/*
+ * Every level but level 0 is one sorted run of at most level0_limit * level_factor ^ level sstables.
+ * Level 0 goes down as a whole, since its sstables overlap each other. Other levels give up one sstable at a time,
+ * picked round-robin by key, merged only with overlapping sstables of next level.
+ * Keeps few runs for reads to probe, at the cost of rewriting a key about level_factor times per level.
+ * With dynamic_level_bytes, limits of levels are bytes derived from size of the last level, see Options.
+ * Once every level is within its limit, sstables dense with tombstones are compacted if tombstone_compaction_ratio is set.
+ */
+class LeveledCompaction : public CompactionPolicy {
+private:
+    size_t level0_limit;
+    size_t level_factor;
+    bool dynamic_level_bytes;
+    size_t max_levels;
+    size_t base_bytes; // Least target of a level that level 0 is compacted into.
+    double tombstone_compaction_ratio;
+    // Key after which next sstable of a level is picked, so that every key range gets its turn.
+    std::vector<long long> compact_cursor;
+
+    size_t levelLimit(size_t level) const;
+
+    DiskTable::DiskTableNodePtr pickFile(DiskTable::DiskViewLevel &level, size_t level_no);
+
+    bool pickByBytes(DiskTable::DiskView &view, Compaction &compaction);
+
+    // An sstable of tombstones more than tombstone_compaction_ratio of its entries, pushed to next level,
+    // or rewritten in place if it's in the last level, where its tombstones are dropped.
+    bool pickTombstones(DiskTable::DiskView &view, Compaction &compaction);
+
+public:
+    explicit LeveledCompaction(const Options &options);
+
+    static size_t bytesOf(const DiskTable::DiskViewLevel &level);
+
+    // Target bytes of every level of view but level 0, and the level level 0 is compacted into.
+    // Levels above that one target 0 bytes.
+    std::vector<size_t> levelTargets(const DiskTable::DiskView &view, size_t &base_level) const;
+
+    bool pick(DiskTable::DiskView &view, Compaction &compaction) override;
+
+    size_t compactionDebt(const DiskTable::DiskView &view) const override;
+};
+
+// A run joins the tier of runs written before it if its size is within this factor of their average size.
+const size_t TIERED_RUN_SIZE_RATIO = 2;
+
+/*
+ * Size-tiered: runs of a level, from oldest to newest, are grouped into tiers of runs of similar size.
+ * Once a tier has more than level_factor runs they are merged into one: the oldest tier of a level into a run of
+ * next level, leaving runs already there untouched, the newest tier into a run at the end of the level, since
+ * older runs of the level are still read after it. A small run arriving never rewrites a large one.
+ * Only the newest tier grows, and merging it leaves tiers before it as they were, so no other tier fills up.
+ * Level 0 goes down as a whole once it has more than level0_limit sstables. Reads probe every run.
+ */
+class TieredCompaction : public CompactionPolicy {
+private:
+    size_t level0_limit;
+    size_t level_factor;
+
+    // Adjacent runs of a level, [begin, end) of its sstables.
+    struct Tier {
+        DiskTable::DiskViewLevel::const_iterator begin;
+        DiskTable::DiskViewLevel::const_iterator end;
+        size_t runs;
+        size_t bytes;
+    };
+
+    // Runs of level, each a tier of its own. Sstables written by one compaction don't overlap each other,
+    // a run ends at an sstable overlapping it.
+    static std::vector<Tier> runsOf(const DiskTable::DiskViewLevel &level);
+
+    // Runs of level grouped by TIERED_RUN_SIZE_RATIO, oldest first.
+    static std::vector<Tier> tiersOf(const DiskTable::DiskViewLevel &level);
+
+public:
+    explicit TieredCompaction(const Options &options);
+
+    bool pick(DiskTable::DiskView &view, Compaction &compaction) override;
+
+    size_t compactionDebt(const DiskTable::DiskView &view) const override;
+};
+
+
+#endif //LSMTREE_COMPACTIONPOLICY_H
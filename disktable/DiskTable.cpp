@@ -3,78 +3,231 @@
 //
 
 #include "DiskTable.h"
+#include "CompactionPolicy.h"
+#include "../thread_pool/ThreadPool.h"
+#include <cmath>
+#include <climits>
 
-DiskTableNode::DiskTableNode() : _sstable{nullptr}, filter{nullptr}, index{nullptr} {
+DiskTableNode::DiskTableNode(std::shared_ptr<BlockCache> cache) : _sstable{nullptr}, filter{nullptr}, index{nullptr},
+                                                                   learned{nullptr}, rangeFilter{nullptr},
+                                                                   partitions{nullptr}, blockCache{std::move(cache)},
+                                                                   cache_owner{BlockCache::newOwner()} {
 } // For writing.
 
-DiskTableNode::DiskTableNode(const path &p) : _sstable{new SSTable{p}}, filter{nullptr}, index{nullptr} {
+DiskTableNode::DiskTableNode(const path &p, std::shared_ptr<BlockCache> cache) : _sstable{new SSTable{p}},
+                                                                                 filter{nullptr}, index{nullptr},
+                                                                                 learned{nullptr}, rangeFilter{nullptr},
+                                                                                 partitions{nullptr},
+                                                                                 blockCache{std::move(cache)},
+                                                                                 cache_owner{BlockCache::newOwner()} {
+}
+
+DiskTableNode::DiskTableNode(const path &p, const ManifestFile &f, std::shared_ptr<BlockCache> cache)
+        : DiskTableNode(p, std::move(cache)) {
+    range_known = true;
+    key_min = f.key_min;
+    key_max = f.key_max;
+    file_size = f.file_size;
+    entries = f.entries;
+    tombstones = f.tombstones;
 }
 
 DiskTableNode::~DiskTableNode() {
+    if (obsolete && _sstable != nullptr) {
+        _sstable->removeFromDisk();
+    }
     delete _sstable;
     delete filter;
     delete index;
+    delete learned;
+    delete rangeFilter;
+    delete partitions;
+    delete rangeTombstones;
+}
+
+std::pair<long long, long long> DiskTableNode::keyRange() {
+    if (range_known) {
+        return {key_min, key_max};
+    }
+    auto *h = getHeader();
+    return {h->key_min, h->key_max};
 }
 
 SSTableHeader *DiskTableNode::getHeader() {
+    std::call_once(header_once, [this] { _sstable->getHeader(); });
     return _sstable->getHeader();
 }
 
 void DiskTableNode::loadIndexFilter() {
-    if (index == nullptr && filter == nullptr) {
-        // Info from _sstable->index is used to generate filter and index, dont need after that.
-        auto ssindex = SSTableIndex{std::move(*_sstable->getIndex())};
-        index = new IndexMap{};
-        auto count = getHeader()->entries_count;
-        filter = new Filter{10 * count, count, 0};
-        for (const auto &item:ssindex) {
-            index->insert({item.key, item.offset});
-            filter->add(item.key);
+    std::call_once(filter_once, [this] {
+        getHeader();
+        partitions = _sstable->readPartitionedFilterHead();
+        if (partitions == nullptr) {
+            filter = _sstable->readFilter();
         }
+        learned = _sstable->readLearnedIndex();
+        rangeFilter = _sstable->readRangeFilter();
+        metadata_bytes += (partitions != nullptr ? partitions->size_bytes() : filter->size_bytes()) +
+                          (learned != nullptr ? learned->size_bytes() : 0) +
+                          (rangeFilter != nullptr ? rangeFilter->size_bytes() : 0);
+    });
+    if (partitions == nullptr && learned == nullptr) {
+        getIndex();
     }
 }
 
-DiskTableNode::IndexMap *DiskTableNode::getIndex() {
-    if (index == nullptr || index->empty() || index->size() == 0) {
-        loadIndexFilter();
+template<typename T, typename Load>
+std::shared_ptr<const T> DiskTableNode::cachedBlock(uint64_t offset, Load load) {
+    if (blockCache != nullptr) {
+        auto block = blockCache->lookup(cache_owner, offset);
+        if (block != nullptr) {
+            return std::static_pointer_cast<const T>(block);
+        }
+    }
+    // A load failing throws before anything is cached, so a later read tries it again.
+    auto[block, charge] = load();
+    if (blockCache != nullptr) {
+        blockCache->insert(cache_owner, offset, block, charge);
     }
+    return block;
+}
+
+std::shared_ptr<const SSTableFilter> DiskTableNode::filterPartition(size_t p) {
+    return cachedBlock<SSTableFilter>(getHeader()->filter_offset + partitions->offsets[p], [this, p] {
+        auto block = std::shared_ptr<const SSTableFilter>{_sstable->readFilterPartition(*partitions, p)};
+        return std::make_pair(block, block->size_bytes());
+    });
+}
+
+std::shared_ptr<const SSTableIndex> DiskTableNode::indexPartition(size_t p) {
+    const auto item_size = sizeof(long long) + sizeof(size_t);
+    auto first = p * partitions->restarts_per_partition;
+    return cachedBlock<SSTableIndex>(getHeader()->index_offset + first * item_size, [this, first, item_size] {
+        auto block = std::make_shared<const SSTableIndex>(
+                _sstable->readIndexRange(first, first + partitions->restarts_per_partition));
+        return std::make_pair(std::static_pointer_cast<const SSTableIndex>(block), block->size() * item_size);
+    });
+}
+
+void DiskTableNode::loadIndex() {
+    // Info from _sstable->index is used to generate index of restart points, dont need after that.
+    getHeader();
+    auto ssindex = SSTableIndex{std::move(*_sstable->getIndex())};
+    index = new IndexMap{};
+    index->reserve(ssindex.size());
+    for (const auto &item:ssindex) {
+        index->push_back(item.key, item.offset);
+    }
+    metadata_bytes += index->size() * (sizeof(long long) + sizeof(size_t));
+}
+
+void DiskTableNode::warmUp() {
+    loadIndexFilter();
+}
+
+size_t DiskTableNode::metadataBytes() const {
+    return metadata_bytes.load();
+}
+
+DiskTableNode::IndexMap *DiskTableNode::getIndex() {
+    // Load restart index even if there is a learned index, since caller asks for it explicitly.
+    std::call_once(index_once, [this] { loadIndex(); });
     return index;
 }
 
 DiskTableNode::Filter *DiskTableNode::getFilter() {
-    if (filter == nullptr) {
-        loadIndexFilter();
-    }
+    loadIndexFilter();
     return filter;
 }
 
-SSTableDataEntry DiskTableNode::getEntry(long long key) {
+DiskTableNode::RestartInterval DiskTableNode::restartOf(long long key) {
+    loadIndexFilter();
+    auto index_end = getHeader()->index_offset;
+    if (partitions != nullptr) {
+        auto p = partitions->partitionOf(key);
+        if (p == partitions->first_keys.size()) {
+            return {false, 0, 0};
+        }
+        auto part = indexPartition(p);
+        auto q = std::upper_bound(part->begin(), part->end(), key,
+                                  [](long long k, const SSTableIndexItem &item) { return k < item.key; });
+        // First restart key of partition is its first key, not greater than key, unless partition is malformed.
+        if (q == part->begin()) {
+            return {false, 0, 0};
+        }
+        return {true, std::prev(q)->offset, q == part->end() ? index_end : q->offset};
+    }
+    if (learned != nullptr) {
+        // Only read the window of restart points predicted by learned index from disk,
+        // plus the one after it to know where the restart interval ends.
+        auto[first, last] = learned->search(key);
+        auto window = _sstable->readIndexRange(first, last + 1);
+        auto p = std::upper_bound(window.begin(), window.end(), key,
+                                  [](long long k, const SSTableIndexItem &item) { return k < item.key; });
+        if (p == window.begin()) {
+            return {false, 0, 0};
+        }
+        return {true, std::prev(p)->offset, p == window.end() ? index_end : p->offset};
+    }
     auto *i = getIndex();
-    auto p = i->find(key);
-    if (p == i->end()) {
+    auto p = i->floor(key);
+    if (p == IndexMap::npos) {
+        return {false, 0, 0};
+    }
+    return {true, i->offsetAt(p), p + 1 < i->size() ? i->offsetAt(p + 1) : index_end};
+}
+
+SSTableDataEntry DiskTableNode::getEntry(long long key) {
+    auto interval = restartOf(key);
+    if (!interval.valid) {
         return SSTableDataEntry{false, 0, 0, ""};
     }
-    auto offset = p->second;
-    return _sstable->getEntry(offset);
+    return _sstable->getEntry(key, interval.offset, interval.end_offset);
+}
+
+SSTableData DiskTableNode::getRange(long long lo, long long hi) {
+    if (!mightInRange(lo, hi)) {
+        return SSTableData{};
+    }
+    // No restart point before first key, key_min may be less than it if sstable has range tombstones.
+    auto interval = restartOf(lo);
+    return _sstable->getRange(lo, hi, interval.valid ? interval.offset : SSTABLE_HEADER_SIZE);
+}
+
+bool DiskTableNode::mightInRange(long long lo, long long hi) {
+    auto[min, max] = keyRange();
+    lo = std::max(lo, min);
+    hi = std::min(hi, max);
+    if (lo > hi) {
+        return false;
+    }
+    loadIndexFilter();
+    return rangeFilter == nullptr || rangeFilter->mightContain(lo, hi);
 }
 
 bool DiskTableNode::mightIn(long long key) {
-    auto *h = getHeader();
-    auto *f = getFilter();
-    return key >= h->key_min && key <= h->key_max && f->find(key);
+    auto[min, max] = keyRange();
+    if (key < min || key > max) {
+        return false;
+    }
+    loadIndexFilter();
+    if (partitions != nullptr) {
+        auto p = partitions->partitionOf(key);
+        return p < partitions->first_keys.size() && filterPartition(p)->mightContain(key);
+    }
+    return filter->mightContain(key);
 }
 
 bool DiskTableNode::intersect(DiskTableNode &rhs) {
-    auto *h = getHeader();
-    auto *rh = rhs.getHeader();
-    return ((rh->key_min >= h->key_min && rh->key_min <= h->key_max) ||
-            (rh->key_max >= h->key_min && rh->key_max <= h->key_max)) ||
-           (h->key_min >= rh->key_min && h->key_max <= rh->key_max);
+    auto[min, max] = keyRange();
+    auto[r_min, r_max] = rhs.keyRange();
+    return ((r_min >= min && r_min <= max) ||
+            (r_max >= min && r_max <= max)) ||
+           (min >= r_min && max <= r_max);
 }
 
 bool DiskTableNode::hasKey(long long key) {
-    auto *i = getIndex();
-    return mightIn(key) && index->find(key) != i->end();
+    return mightIn(key) && valid(getEntry(key));
 }
 
 bool DiskTableNode::valid(const SSTableDataEntry &s) {
@@ -86,27 +239,33 @@ bool DiskTableNode::valid(const SSTableDataEntry &s) {
      no given key in the sstable.*/
 }
 
-void DiskTableNode::fillData(SSTableData &new_data) {
+void DiskTableNode::fillData(SSTableData &new_data, const Options &options) {
+    entries = new_data.size();
+    tombstones = std::count_if(new_data.begin(), new_data.end(), [](const SSTableDataEntry &e) { return e.delete_flag; });
     _sstable = new SSTable{};
-    _sstable->fillData(new_data);
+    _sstable->fillData(new_data, options);
 }
 
-void DiskTableNode::writeToDisk(const path &&dst_file) {
+void DiskTableNode::writeToDisk(const path &&dst_file, bool sync, const SSTable::WriteThrottle &throttle) {
     if (_sstable != nullptr) {
-        _sstable->writeToDisk(dst_file);
+        _sstable->writeToDisk(dst_file, sync, throttle);
+        file_size = std::filesystem::file_size(dst_file);
     }
 }
 
 SSTableData *DiskTableNode::getAllData() {
     if (_sstable != nullptr) {
+        getHeader();
         return _sstable->getAllData();
     }
     return nullptr;
 }
 
-void DiskTableNode::fillData(SSTableData &&new_data) {
+void DiskTableNode::fillData(SSTableData &&new_data, const Options &options, RangeTombstones &&range_tombstones) {
+    entries = new_data.size();
+    tombstones = std::count_if(new_data.begin(), new_data.end(), [](const SSTableDataEntry &e) { return e.delete_flag; });
     _sstable = new SSTable{};
-    _sstable->fillData(std::forward<SSTableData>(new_data));
+    _sstable->fillData(std::forward<SSTableData>(new_data), options, std::move(range_tombstones));
 }
 
 void DiskTableNode::clearDataCache() {
@@ -118,27 +277,58 @@ void DiskTableNode::removeFromDisk() {
     delete _sstable;
     delete index;
     delete filter;
+    delete learned;
+    delete rangeFilter;
+    delete partitions;
+    delete rangeTombstones;
     _sstable = nullptr;
     index = nullptr;
     filter = nullptr;
+    learned = nullptr;
+    rangeFilter = nullptr;
+    partitions = nullptr;
+    rangeTombstones = nullptr;
 }
 
-bool DiskTableNode::intersect(SSTableData &rhs) {
-    auto *h = getHeader();
-    auto rkey_min = rhs.begin()->key;
-    auto rkey_max = rhs.rbegin()->key;
-    return ((rkey_min >= h->key_min && rkey_min <= h->key_max) ||
-            (rkey_max >= h->key_min && rkey_max <= h->key_max)) ||
-           (h->key_min >= rkey_min && h->key_max <= rkey_max);
+bool DiskTableNode::intersect(SSTableData &rhs, const RangeTombstones &rhs_tombstones) {
+    // By key range only, not range filter: a node left out of the merge while its key range overlaps rhs's would
+    // overlap sstables written from rhs, and its level would no longer be a single sorted run.
+    auto lo = rhs.begin()->key, hi = rhs.rbegin()->key;
+    for (const auto &t:rhs_tombstones) {
+        lo = std::min(lo, t.lo);
+        hi = std::max(hi, t.hi);
+    }
+    auto[min, max] = keyRange();
+    return min <= hi && lo <= max;
 }
 
 DiskTableNode::DiskTableNode(DiskTableNode &&rhs) noexcept {
     _sstable = rhs._sstable;
     filter = rhs.filter;
     index = rhs.index;
+    learned = rhs.learned;
+    rangeFilter = rhs.rangeFilter;
+    partitions = rhs.partitions;
+    rangeTombstones = rhs.rangeTombstones;
+    blockCache = std::move(rhs.blockCache);
+    cache_owner = rhs.cache_owner;
+    range_known = rhs.range_known;
+    key_min = rhs.key_min;
+    key_max = rhs.key_max;
+    file_size = rhs.file_size;
+    entries = rhs.entries;
+    tombstones = rhs.tombstones;
     rhs._sstable = nullptr;
     rhs.filter = nullptr;
     rhs.index = nullptr;
+    rhs.learned = nullptr;
+    rhs.rangeFilter = nullptr;
+    rhs.partitions = nullptr;
+    rhs.rangeTombstones = nullptr;
+}
+
+void DiskTableNode::markObsolete() {
+    obsolete = true;
 }
 
 path DiskTableNode::getFile() {
@@ -148,143 +338,646 @@ path DiskTableNode::getFile() {
     return path();
 }
 
-DiskTable::QueryResult DiskTable::get(long long int key) {
-    auto cur_level = diskView.begin();
-    auto level_end = diskView.end();
-    for (; cur_level != level_end; cur_level++) {
-        if (cur_level == diskView.begin()) {
-            // To ensure correctness of result, we should lookup one written to disk later first in level 0 (if there are two sstable already).
-            auto cur_node = cur_level->rbegin();
-            auto rend = cur_level->rend();
-            for (; cur_node != rend; cur_node++) {
-                if (cur_node->mightIn(key)) {
-                    auto res = cur_node->getEntry(key);
-                    if (cur_node->valid(res)) {
-                        if (res.delete_flag) {
-                            // Delete record must leave in disk.
-                            // See also comment in DiskTableNode#valid.
-                            return {false, ""};
-                        }
-                        return {true, std::move(res.value)};
+size_t DiskTableNode::number() {
+    return atoll(getFile().stem().c_str());
+}
+
+size_t DiskTableNode::fileSize() {
+    if (file_size == 0 && _sstable != nullptr) {
+        file_size = std::filesystem::file_size(_sstable->getFile());
+    }
+    return file_size;
+}
+
+size_t DiskTableNode::entriesCount() const {
+    return entries;
+}
+
+size_t DiskTableNode::tombstonesCount() const {
+    return tombstones;
+}
+
+size_t DiskTableNode::rangeTombstonesCount() {
+    return getHeader()->range_tombstones;
+}
+
+const RangeTombstones &DiskTableNode::getRangeTombstones() {
+    std::call_once(range_tombstones_once, [this] {
+        rangeTombstones = new RangeTombstones{_sstable->readRangeTombstones()};
+        metadata_bytes += rangeTombstones->size() * sizeof(RangeTombstone);
+    });
+    return *rangeTombstones;
+}
+
+bool DiskTableNode::rangeDeleted(long long key) {
+    auto[min, max] = keyRange();
+    if (key < min || key > max || rangeTombstonesCount() == 0) {
+        return false;
+    }
+    return range_deleted(getRangeTombstones(), key);
+}
+
+ManifestFile DiskTableNode::manifestFile(size_t level) {
+    auto[min, max] = keyRange();
+    return ManifestFile{level, number(), min, max, fileSize(), entries, tombstones};
+}
+
+DiskKeyFilter::DiskKeyFilter(CuckooFilter &&filter) : filter(std::move(filter)) {
+}
+
+bool DiskKeyFilter::mightContain(long long key) {
+    std::shared_lock lock{mutex};
+    return filter.mightContain(key);
+}
+
+bool DiskKeyFilter::add(const SSTableData &data) {
+    std::unique_lock lock{mutex};
+    for (const auto &entry:data) {
+        // Skip keys already present, so updates of hot keys don't fill up their buckets.
+        if (!filter.mightContain(entry.key) && !filter.add(entry.key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DiskKeyFilter::replace(CuckooFilter &&new_filter) {
+    std::unique_lock lock{mutex};
+    filter = std::move(new_filter);
+}
+
+bool DiskKeyFilter::full() {
+    std::shared_lock lock{mutex};
+    return filter.full();
+}
+
+void DiskKeyFilter::save(std::ostream &os) {
+    std::shared_lock lock{mutex};
+    os << filter;
+}
+
+CuckooFilter DiskTable::buildKeyFilter(const DiskView &view) {
+    size_t entries = 0;
+    for (const auto &level:view) {
+        for (const auto &node:level) {
+            entries += node->getHeader()->entries_count;
+        }
+    }
+    // Room for as many new keys as there are now before it's rebuilt again.
+    auto capacity = std::max(entries * 2, static_cast<size_t>(1) << 16);
+    while (true) {
+        auto filter = CuckooFilter{capacity};
+        auto full = false;
+        for (auto level = view.begin(); level != view.end() && !full; level++) {
+            for (auto node = level->begin(); node != level->end() && !full; node++) {
+                // Read through an SSTable of its own, compaction may be reading data of node at the same time.
+                auto sstable = SSTable{(*node)->getFile()};
+                for (const auto &entry:*sstable.getAllData()) {
+                    // A key dropped by a full filter would be a false negative, filter is rebuilt larger instead.
+                    if (!filter.mightContain(entry.key) && !filter.add(entry.key)) {
+                        full = true;
+                        break;
                     }
                 }
             }
-        } else {
-            auto cur_node = cur_level->begin();
-            auto end = cur_level->end();
-            for (; cur_node != end; cur_node++) {
-                if (cur_node->mightIn(key)) {
-                    auto res = cur_node->getEntry(key);
-                    if (cur_node->valid(res)) {
-                        if (res.delete_flag) {
-                            return {false, ""};
-                        }
-                        return {true, std::move(res.value)};
+        }
+        if (!full) {
+            return filter;
+        }
+        capacity *= 2;
+    }
+}
+
+double DiskTable::filterBitsPerKey(size_t level, size_t levels) const {
+    if (!options.filter_bits_per_level) {
+        return options.filter_bits_per_key;
+    }
+    /*
+     * Level i holds up to c_i = level0_limit * level_factor^i sstables. With false positive rate p_i proportional to c_i,
+     * bits per key of level i is b_last + ln(c_last / c_i) / ln(2)^2, and b_last is chosen so that the average over
+     * all entries, weighted by c_i, equals filter_bits_per_key. Filters are never given less than 1 bit per key.
+     */
+    levels = std::max(levels, level + 1);
+    const auto ln2_2 = std::log(2) * std::log(2);
+    auto capacity_of = [this](size_t i) {
+        return options.level0_limit * std::pow(static_cast<double>(options.level_factor), static_cast<double>(i));
+    };
+    auto last = capacity_of(levels - 1);
+    double total = 0, extra = 0;
+    for (size_t i = 0; i < levels; i++) {
+        total += capacity_of(i);
+        extra += capacity_of(i) * std::log(last / capacity_of(i)) / ln2_2;
+    }
+    auto last_bits = options.filter_bits_per_key - extra / total;
+    return std::max(last_bits + std::log(last / capacity_of(level)) / ln2_2, 1.0);
+}
+
+Options DiskTable::optionsOfLevel(size_t level, size_t levels) const {
+    auto level_options = options;
+    if (options.filter_bits_per_level) {
+        level_options.filter_bits_per_key = filterBitsPerKey(level, levels);
+        level_options.filter_hashes = 0;
+    }
+    return level_options;
+}
+
+size_t DiskTable::metadataBytes() {
+    auto version = current();
+    size_t total = 0;
+    for (const auto &level:*version) {
+        for (const auto &node:level) {
+            total += node->metadataBytes();
+        }
+    }
+    return total;
+}
+
+std::shared_ptr<BlockCache> DiskTable::getBlockCache() {
+    return blockCache;
+}
+
+DiskTable::KeyFilterPtr DiskTable::keyFilter() {
+    return keys;
+}
+
+size_t DiskTable::clock() {
+    std::lock_guard lock{clock_mutex};
+    return SSTableClock;
+}
+
+DiskTable::Version DiskTable::current() {
+    return std::atomic_load(&diskView);
+}
+
+DiskTable::QueryResult DiskTable::get(long long int key) {
+    return get(current(), key, options.merge_operator);
+}
+
+DiskTable::QueryResult DiskTable::get(const Version &version, long long int key, const MergeOperator &merge_operator) {
+    auto found = SSTableDataEntry{};
+    auto merging = false; // found is a merge entry, waiting for older entries of key.
+    auto result_of = [&merge_operator](SSTableDataEntry &entry) -> QueryResult {
+        merge_entries(merge_operator, entry, nullptr);
+        if (entry.delete_flag) {
+            // Delete record must leave in disk.
+            // See also comment in DiskTableNode#valid.
+            return {false, ""};
+        }
+        return {true, std::move(entry.value)};
+    };
+    for (const auto &level:*version) {
+        // To ensure correctness of result, we should lookup one written to disk later first, sstables of level 0
+        // overlap each other, so do runs of a level under tiered compaction.
+        for (auto cur_node = level.rbegin(); cur_node != level.rend(); cur_node++) {
+            if ((*cur_node)->mightIn(key)) {
+                auto res = (*cur_node)->getEntry(key);
+                if ((*cur_node)->valid(res)) {
+                    if (merging) {
+                        merge_entries(merge_operator, found, &res);
+                    } else {
+                        found = std::move(res);
+                    }
+                    merging = found.merge_flag;
+                    if (!merging) {
+                        return result_of(found);
                     }
                 }
             }
+            // Entries of an sstable are written after its range tombstones, so they are checked first.
+            if ((*cur_node)->rangeDeleted(key)) {
+                return merging ? result_of(found) : QueryResult{false, ""};
+            }
         }
     }
-    return {false, ""};
+    return merging ? result_of(found) : QueryResult{false, ""};
 }
 
-void DiskTable::persistent(MemTable &&m, bool df) {
-    auto new_disk_node = DiskTableNode{};
-    new_disk_node.fillData(m.collectData());
-    auto level0 = diskView.begin();
-    auto writeFileName = [this](DiskViewLevelIter level) {
-        this->SSTableClock += 1;
-        auto parent_dir = this->db_home / path{std::to_string(std::distance(this->diskView.begin(), level))};
-        if (!exists(parent_dir)) {
-            create_directory(parent_dir);
+void DiskTable::addScanned(std::map<long long, SSTableDataEntry> &result, SSTableDataEntry &&entry,
+                           const MergeOperator &merge_operator) {
+    auto key = entry.key;
+    auto[p, added] = result.try_emplace(key, std::move(entry));
+    if (!added && p->second.merge_flag) {
+        merge_entries(merge_operator, p->second, &entry); // Not moved from if key was in result.
+    }
+}
+
+void DiskTable::scan(const Version &version, long long lo, long long hi,
+                     std::map<long long, SSTableDataEntry> &result, RangeTombstones &deleted,
+                     const MergeOperator &merge_operator) {
+    auto add_node = [&](const DiskTableNodePtr &node) {
+        if (node->mightInRange(lo, hi)) {
+            for (auto &entry:node->getRange(lo, hi)) {
+                if (!range_deleted(deleted, entry.key)) {
+                    addScanned(result, std::move(entry), merge_operator);
+                }
+            }
+        }
+        auto[min, max] = node->keyRange();
+        if (min <= hi && lo <= max && node->rangeTombstonesCount() != 0) {
+            const auto &tombstones = node->getRangeTombstones();
+            deleted.insert(deleted.end(), tombstones.begin(), tombstones.end());
+            coalesce_range_tombstones(deleted);
         }
-        return parent_dir / (path{std::to_string(this->SSTableClock) + ".bin"});
     };
-    if (level0->size() < LEVEL0_LIMIT) {
-        new_disk_node.writeToDisk(writeFileName(level0));
-        new_disk_node.clearDataCache();
-        level0->push_back(std::move(new_disk_node));
+    for (const auto &level:*version) {
+        // Later sstables first, see DiskTable::get.
+        std::for_each(level.rbegin(), level.rend(), add_node);
+    }
+}
+
+void DiskTable::persistent(MemTable &m, bool df) {
+    auto new_disk_node = std::make_shared<DiskTableNode>(blockCache);
+    auto new_data = m.collectData();
+    // Keys must be in the filter before any reader can see the new version.
+    auto keys_full = keys != nullptr && !keys->add(new_data);
+    auto edit = VersionEdit{};
+    new_disk_node->fillData(std::move(new_data), optionsOfLevel(0, current()->size()), m.collectRangeTombstones());
+    new_disk_node->writeToDisk(newFileName(0), options.sync_files, throttleOf(RateLimiter::Priority::High));
+    new_disk_node->clearDataCache();
+    edit.added.push_back(new_disk_node->manifestFile(0));
+    std::lock_guard lock{install_mutex};
+    // Work on a copy of current version, readers keep using the old one until the new one is installed.
+    auto view = std::make_shared<DiskView>(*current());
+    view->front().push_back(std::move(new_disk_node));
+    auto obsolete = DiskViewLevel{};
+    if (!background_compaction) {
+        auto compaction = Compaction{};
+        while (policy->pick(*view, compaction)) {
+            compact(*view, compaction, edit, obsolete);
+        }
+    }
+    tuneRateLimiter(*view);
+    install(view, edit, keys_full, obsolete);
+}
+
+bool DiskTable::compactOnce() {
+    auto base = current();
+    auto view = std::make_shared<DiskView>(*base);
+    auto compaction = Compaction{};
+    if (!policy->pick(*view, compaction)) {
+        return false;
+    }
+    auto edit = VersionEdit{};
+    auto obsolete = DiskViewLevel{};
+    compact(*view, compaction, edit, obsolete);
+    std::lock_guard lock{install_mutex};
+    // Flushes installed meanwhile only appended sstables to level 0, which compaction never writes into.
+    const auto &flushed = current()->front();
+    std::copy(std::next(flushed.begin(), base->front().size()), flushed.end(), std::back_inserter(view->front()));
+    tuneRateLimiter(*view);
+    install(view, edit, false, obsolete);
+    return true;
+}
+
+path DiskTable::newFileName(size_t level) {
+    std::lock_guard lock{clock_mutex};
+    SSTableClock += 1;
+    auto parent_dir = db_home / path{std::to_string(level)};
+    if (!exists(parent_dir)) {
+        create_directory(parent_dir);
+        if (options.sync_files) {
+            sync_path(db_home);
+        }
+    }
+    return parent_dir / (path{std::to_string(SSTableClock) + ".bin"});
+}
+
+void DiskTable::compact(DiskView &view, Compaction &compaction, VersionEdit &edit, DiskViewLevel &obsolete) {
+    auto level = compaction.output_level;
+    while (level >= view.size()) {
+        view.push_back(DiskViewLevel{});
+    }
+    auto &inputs = compaction.inputs;
+    auto &into = view[level];
+    if (canMove(compaction, into)) {
+        for (auto node = inputs.rbegin(); node != inputs.rend(); node++) {
+            moveFile(view, level, *node, edit, obsolete);
+        }
         return;
     }
-    if (level0->size() == LEVEL0_LIMIT) {
-        auto cur_level = diskView.begin();
-        if (std::next(cur_level) == diskView.end()) {
-            diskView.push_back(DiskViewLevel{});
-        }
-        auto compaction_into_level = std::next(cur_level);
-        auto compaction_into_level_limit = LEVEL0_LIMIT * LEVEL_FACTOR;
-        auto overflow_data = SSTableData{};
-        auto to_remove_file = std::list<path>{};
-        while (true) {
-            if (cur_level == diskView.begin()) {
-                auto level0_0 = cur_level->begin();
-                auto level0_1 = std::next(level0_0, 1);
-                overflow_data = merge(new_disk_node.getAllData(), level0_1->getAllData(), level0_0->getAllData());
-                to_remove_file.push_back(level0_1->getFile());
-                to_remove_file.push_back(level0_0->getFile());
-                level0->clear();
+    chargeIO(inputs.front()->fileSize(), RateLimiter::Priority::Low);
+    auto merged = SSTableData{*inputs.front()->getAllData()};
+    auto deleted = inputs.front()->getRangeTombstones();
+    inputs.front()->clearDataCache();
+    // Every sstable merged is older than those before it, range tombstones of those are applied to it.
+    auto merge_node = [this, &merged, &deleted](const DiskTableNodePtr &node) {
+        chargeIO(node->fileSize(), RateLimiter::Priority::Low);
+        auto *data = node->getAllData();
+        dropRangeDeleted(*data, deleted);
+        merged = merge(&merged, data);
+        node->clearDataCache();
+        const auto &tombstones = node->getRangeTombstones();
+        deleted.insert(deleted.end(), tombstones.begin(), tombstones.end());
+        coalesce_range_tombstones(deleted);
+    };
+    std::for_each(std::next(inputs.begin()), inputs.end(), merge_node);
+    for (auto node = into.begin(); compaction.merge_next_level && node != into.end();) {
+        if ((*node)->intersect(merged, deleted)) {
+            merge_node(*node);
+            inputs.push_back(*node);
+            node = into.erase(node);
+            continue;
+        }
+        node++;
+    }
+    auto lo = merged.front().key, hi = merged.back().key;
+    for (const auto &t:deleted) {
+        lo = std::min(lo, t.lo);
+        hi = std::max(hi, t.hi);
+    }
+    if (bottommost(view, compaction, lo, hi)) {
+        // Nothing older a merge entry applies to is left either.
+        for (auto &entry:merged) {
+            merge_entries(options.merge_operator, entry, nullptr);
+        }
+        // Nothing older a tombstone hides is left, merge has dropped older versions of its key already.
+        merged.erase(std::remove_if(merged.begin(), merged.end(),
+                                    [](const SSTableDataEntry &e) { return e.delete_flag; }), merged.end());
+        deleted.clear();
+    }
+    writeLevel(view, level, merged, deleted, edit);
+    for (auto &node:inputs) {
+        edit.removed.push_back(node->number());
+        obsolete.push_back(node);
+    }
+}
+
+bool DiskTable::bottommost(const DiskView &view, const Compaction &compaction, long long lo, long long hi) {
+    for (auto level = compaction.output_level; level < view.size(); level++) {
+        // Sstables of output level overlapping inputs are merged with them under leveled compaction.
+        if (level == compaction.output_level && compaction.merge_next_level) {
+            continue;
+        }
+        for (const auto &node:view[level]) {
+            auto[min, max] = node->keyRange();
+            if (min <= hi && lo <= max) {
+                return false;
             }
+        }
+    }
+    return true;
+}
 
-            for (auto to_compaction_node = compaction_into_level->begin();
-                 to_compaction_node != compaction_into_level->end();) {
-                if (to_compaction_node->intersect(overflow_data)) {
-                    overflow_data = merge(&overflow_data, to_compaction_node->getAllData());
-                    to_compaction_node->clearDataCache();
-                    to_remove_file.push_back(to_compaction_node->getFile());
-                    to_compaction_node = compaction_into_level->erase(to_compaction_node);
-                    continue;
-                }
-                to_compaction_node++;
+bool DiskTable::canMove(Compaction &compaction, DiskViewLevel &into) {
+    auto &inputs = compaction.inputs;
+    if (compaction.output_level == compaction.level) {
+        return false; // Sstable is rewritten in place to drop its tombstones.
+    }
+    for (auto node = inputs.begin(); node != inputs.end(); node++) {
+        for (auto other = std::next(node); other != inputs.end(); other++) {
+            if ((*node)->intersect(**other)) {
+                return false;
             }
+        }
+        if (compaction.merge_next_level && std::any_of(into.begin(), into.end(), [&node](DiskTableNodePtr &n) {
+            return n->intersect(**node);
+        })) {
+            return false;
+        }
+    }
+    return true;
+}
 
-            auto cur_overflow_entry = overflow_data.begin();
-            auto overflow_end = overflow_data.end();
+void DiskTable::moveFile(DiskView &view, size_t level, DiskTableNodePtr &node, VersionEdit &edit,
+                         DiskViewLevel &obsolete) {
+    // Readers of older versions still read node by its path, so file is linked under a new number in level,
+    // old name is removed with node once they are done.
+    auto file = newFileName(level);
+    auto ec = std::error_code{};
+    create_hard_link(node->getFile(), file, ec);
+    if (ec) {
+        chargeIO(node->fileSize(), RateLimiter::Priority::Low);
+        copy_file(node->getFile(), file);
+    }
+    if (options.sync_files) {
+        sync_path(file.parent_path());
+    }
+    auto moved = std::make_shared<DiskTableNode>(file, node->manifestFile(level), blockCache);
+    edit.added.push_back(moved->manifestFile(level));
+    edit.removed.push_back(node->number());
+    obsolete.push_back(node);
+    view[level].push_back(std::move(moved));
+}
 
-            while (compaction_into_level->size() < compaction_into_level_limit && cur_overflow_entry != overflow_end) {
-                auto persistent_data_block = SSTableData{};
-                volatile size_t blocked_data_bytes = 0;
-                while (blocked_data_bytes <= SSTABLE_SIZE_LIMIT && cur_overflow_entry != overflow_end) {
-                    blocked_data_bytes += size_of_entry(*cur_overflow_entry);
-                    persistent_data_block.push_back(*cur_overflow_entry);
-                    cur_overflow_entry++;
-                }
-                auto persistent_node = DiskTableNode{};
-                persistent_node.fillData(std::move(persistent_data_block));
-                persistent_node.writeToDisk(writeFileName(compaction_into_level));
-                persistent_node.clearDataCache();
-                compaction_into_level->push_back(std::move(persistent_node));
-            }
+void DiskTable::dropRangeDeleted(SSTableData &data, const RangeTombstones &deleted) {
+    if (deleted.empty()) {
+        return;
+    }
+    data.erase(std::remove_if(data.begin(), data.end(), [&deleted](const SSTableDataEntry &e) {
+        return range_deleted(deleted, e.key);
+    }), data.end());
+}
 
-            if (cur_overflow_entry == overflow_end) {
-                std::for_each(to_remove_file.begin(), to_remove_file.end(), [](path &file) { remove(file); });
-                overflow_data.clear();
-                break;
+void DiskTable::writeLevel(DiskView &view, size_t level, SSTableData &data, const RangeTombstones &tombstones,
+                           VersionEdit &edit) {
+    auto cur_entry = data.begin();
+    auto block_lo = LLONG_MIN;
+    while (cur_entry != data.end()) {
+        auto persistent_data_block = SSTableData{};
+        size_t blocked_data_bytes = 0;
+        while (blocked_data_bytes <= options.sstable_size && cur_entry != data.end()) {
+            blocked_data_bytes += size_of_entry(*cur_entry);
+            persistent_data_block.push_back(std::move(*cur_entry));
+            cur_entry++;
+        }
+        auto block_hi = cur_entry != data.end() ? cur_entry->key - 1 : LLONG_MAX;
+        auto block_tombstones = RangeTombstones{};
+        for (const auto &t:tombstones) {
+            if (t.lo <= block_hi && block_lo <= t.hi) {
+                block_tombstones.push_back({std::max(t.lo, block_lo), std::min(t.hi, block_hi)});
             }
+        }
+        block_lo = block_hi + 1; // Unused after the last sstable, so never overflows.
+        auto persistent_node = std::make_shared<DiskTableNode>(blockCache);
+        persistent_node->fillData(std::move(persistent_data_block), optionsOfLevel(level, view.size()),
+                                  std::move(block_tombstones));
+        persistent_node->writeToDisk(newFileName(level), options.sync_files, throttleOf(RateLimiter::Priority::Low));
+        persistent_node->clearDataCache();
+        edit.added.push_back(persistent_node->manifestFile(level));
+        view[level].push_back(std::move(persistent_node));
+    }
+}
 
-            if (std::next(compaction_into_level) == diskView.end()) {
-                diskView.push_back(DiskViewLevel{});
-            }
+void DiskTable::chargeIO(size_t bytes, RateLimiter::Priority priority) {
+    if (options.rate_limiter != nullptr) {
+        options.rate_limiter->request(bytes, priority);
+    }
+}
+
+SSTable::WriteThrottle DiskTable::throttleOf(RateLimiter::Priority priority) {
+    if (options.rate_limiter == nullptr) {
+        return nullptr;
+    }
+    return [limiter = options.rate_limiter, priority](size_t bytes) { limiter->request(bytes, priority); };
+}
+
+void DiskTable::tuneRateLimiter(const DiskView &view) {
+    if (options.rate_limiter != nullptr) {
+        options.rate_limiter->tune(this, policy->compactionDebt(view));
+    }
+}
 
-            cur_level++;
-            compaction_into_level++;
-            compaction_into_level_limit *= LEVEL_FACTOR;
+void DiskTable::install(const std::shared_ptr<DiskView> &view, VersionEdit &edit, bool keys_full,
+                        const DiskViewLevel &obsolete) {
+    // Files of the edit are written already, a crash before the record is complete leaves them unreferenced.
+    {
+        std::lock_guard lock{clock_mutex};
+        edit.clock = SSTableClock;
+    }
+    edit.levels = view->size();
+    manifest.append(edit);
+    auto live_files = size_t{0};
+    for (const auto &level:*view) {
+        live_files += level.size();
+    }
+    if (manifest.shouldRewrite(live_files)) {
+        manifest.rewrite(manifestLevels(*view), edit.clock);
+    }
+    if (keys_full) {
+        keys->replace(buildKeyFilter(*view));
+    }
+    std::atomic_store(&diskView, Version{view});
+    // Only now that the edit removing them is durable, files of nodes dropped by it are removed once no reader
+    // holds a version containing them. If append throws, current version still references them.
+    for (const auto &node:obsolete) {
+        node->markObsolete();
+    }
+}
+
+Manifest::Levels DiskTable::manifestLevels(const DiskView &view) {
+    auto levels = Manifest::Levels{};
+    for (const auto &level:view) {
+        auto files = std::vector<ManifestFile>{};
+        for (const auto &node:level) {
+            files.push_back(node->manifestFile(levels.size()));
         }
+        levels.push_back(std::move(files));
     }
+    return levels;
 }
 
-DiskTable::DiskTable(path &db_dir) {
+DiskTable::DiskTable(path &db_dir, const Options &options, size_t clock_floor) : options(sanitized(options)),
+                                                              background_compaction(options.rate_limiter != nullptr),
+                                                              manifest(db_dir / "MANIFEST", options.sync_files) {
     /*
-     * Scan db_dir, build diskView.
      * Structure of db_dir like this:
          db_dir
               | <dir> 0
               | <dir> 1
               | <dir> ...
-              | sstable.lock // store SSTableClock, for simplifying naming of SSTable.
+              | MANIFEST // log of sstables added and removed in every level, and SSTableClock.
      * Every sub dir corresponding to a level according to its name(level number)
      * In every sub dir, there are some SSTable, whose filename is just SSTableClock when it was written to disk,
      * such naming is for convenience of relocating SSTable in a level when compaction.
+     * diskView is built by replaying MANIFEST, db_dir without one is scanned and a MANIFEST is written for it.
+     * An sstable only takes effect once the manifest record of the persistent writing it is complete,
+     * db_dir/RUNNING exists while a DiskTable is open, if it's found on startup, files left by a crash are removed.
     */
+    db_home = db_dir;
+    policy = CompactionPolicy::create(this->options);
+    blockCache = std::make_shared<BlockCache>(options.block_cache_bytes, options.block_cache_shards);
+    if (!exists(db_dir)) {
+        create_directory(db_dir);
+    }
+    auto levels = Manifest::Levels{};
+    auto view = std::shared_ptr<DiskView>{};
+    SSTableClock = clock_floor;
+    if (manifest.replay(levels, SSTableClock)) {
+        SSTableClock = std::max(SSTableClock, clock_floor);
+        if (exists(db_dir / "RUNNING")) {
+            removeOrphans(levels);
+        }
+        view = replayManifest(levels);
+        auto live_files = size_t{0};
+        for (const auto &level:levels) {
+            live_files += level.size();
+        }
+        if (manifest.shouldRewrite(live_files)) {
+            manifest.rewrite(levels, SSTableClock);
+        }
+    } else {
+        view = scanLevels();
+        manifest.rewrite(manifestLevels(*view), SSTableClock);
+        if (exists(db_dir / "sstable.lock")) {
+            remove(db_dir / "sstable.lock"); // SSTableClock is kept in MANIFEST from now on.
+        }
+    }
+    create_binary_ofstream(db_dir / "RUNNING");
+    if (options.warm_up_threads > 0) {
+        warmUp(*view);
+    }
+    if (options.key_filter) {
+        keys = std::make_shared<DiskKeyFilter>(loadKeyFilter(*view));
+    }
+    std::atomic_store(&diskView, Version{view});
+}
+
+Options DiskTable::sanitized(const Options &options) {
+    auto checked = options;
+    // Levels would never grow with a level_factor of 1, and a level_factor of 0 is a division by zero.
+    checked.level_factor = std::max<size_t>(options.level_factor, 2);
+    return checked;
+}
+
+void DiskTable::warmUp(const DiskView &view) {
+    auto pool = ThreadPool{options.warm_up_threads};
+    auto loading = std::vector<std::future<void>>{};
+    for (const auto &level:view) {
+        for (const auto &node:level) {
+            loading.push_back(pool.submit([node] { node->warmUp(); }));
+        }
+    }
+    for (size_t i = 0; i < loading.size(); i++) {
+        loading[i].get(); // Rethrow if sstable can't be read.
+        if (options.warm_up_progress) {
+            options.warm_up_progress(i + 1, loading.size());
+        }
+    }
+}
+
+void DiskTable::removeOrphans(const Manifest::Levels &levels) {
+    auto live = std::set<path>{};
+    for (const auto &level:levels) {
+        for (const auto &f:level) {
+            live.insert(db_home / std::to_string(f.level) / (std::to_string(f.number) + ".bin"));
+        }
+    }
+    for (const auto &level_dir:directory_iterator{db_home}) {
+        if (!level_dir.is_directory()) {
+            continue;
+        }
+        auto removed = false;
+        for (const auto &sstable_file:directory_iterator{level_dir.path()}) {
+            auto ext = sstable_file.path().extension();
+            if ((ext == ".bin" || ext == ".tmp") && live.count(sstable_file.path()) == 0) {
+                remove(sstable_file.path());
+                removed = true;
+            }
+        }
+        if (removed && options.sync_files) {
+            sync_path(level_dir.path());
+        }
+    }
+}
+
+std::shared_ptr<DiskTable::DiskView> DiskTable::replayManifest(const Manifest::Levels &levels) {
+    auto view = std::make_shared<DiskView>();
+    view->reserve(64);
+    for (const auto &level:levels) {
+        auto new_view_level = DiskViewLevel{};
+        for (const auto &f:level) {
+            auto file = db_home / std::to_string(f.level) / (std::to_string(f.number) + ".bin");
+            new_view_level.push_back(std::make_shared<DiskTableNode>(file, f, blockCache));
+        }
+        view->push_back(std::move(new_view_level));
+    }
+    if (view->empty()) {
+        view->push_back(DiskViewLevel{});
+    }
+    return view;
+}
+
+std::shared_ptr<DiskTable::DiskView> DiskTable::scanLevels() {
     static auto compare_dir_entry_by_numeric_asc = [](directory_entry &candidate, directory_entry &current) {
         if (current.is_directory()) {
             auto candidate_dir_name = --(candidate.path().end());
@@ -300,20 +993,14 @@ DiskTable::DiskTable(path &db_dir) {
             return atoll(candidate.path().filename().c_str()) < atoll(current.path().filename().c_str());
         }
     };
-    db_home = db_dir;
-    if (!exists(db_dir)) {
-        create_directory(db_dir);
-    }
-    if (!exists(db_dir / "sstable.lock")) {
-        SSTableClock = 0;
-    } else {
-        auto clock_is = create_binary_ifstream(db_dir / "sstable.lock");
+    if (exists(db_home / "sstable.lock")) {
+        auto clock_is = create_binary_ifstream(db_home / "sstable.lock");
         bytes_read(clock_is, &SSTableClock);
     }
 
-    diskView = DiskView{};
-    diskView.reserve(64);
-    auto dir = directory_iterator{db_dir};
+    auto view = std::make_shared<DiskView>();
+    view->reserve(64);
+    auto dir = directory_iterator{db_home};
     auto dir_buf = std::vector<directory_entry>{}; // directory_iterator is out-of-order, use a buf to sort them.
     for (const auto &d:dir) {
         if (d.is_directory()) {
@@ -322,28 +1009,72 @@ DiskTable::DiskTable(path &db_dir) {
         }
     }
     if (dir_buf.empty()) {
-        create_directory(db_dir / "0");
-        dir_buf.emplace_back(db_dir / "0");
+        create_directory(db_home / "0");
+        dir_buf.emplace_back(db_home / "0");
     }
     std::sort(dir_buf.begin(), dir_buf.end(), compare_dir_entry_by_numeric_asc);
     for (const auto &level:dir_buf) {
         auto new_view_level = DiskViewLevel{};
         auto node_path_buf = std::vector<directory_entry>{};
         for (const auto &sstable_file:directory_iterator{level.path()}) {
-            node_path_buf.push_back(sstable_file);
+            if (sstable_file.path().extension() == ".bin") {
+                node_path_buf.push_back(sstable_file);
+            } else if (sstable_file.path().extension() == ".tmp") {
+                remove(sstable_file.path()); // Left by a crash during writing.
+            }
         }
         // To ensure correctness, we must enforce that sstable written later in level 0 placed into diskView[0][1](if exists)
         std::sort(node_path_buf.begin(), node_path_buf.end(), compare_dir_entry_by_numeric_asc);
         for (const auto &node_path:node_path_buf) {
-            new_view_level.emplace_back(node_path);
+            new_view_level.push_back(std::make_shared<DiskTableNode>(node_path, blockCache));
+            // Never reuse a number of existing sstable, even if sstable.lock is missing.
+            SSTableClock = std::max(SSTableClock, new_view_level.back()->number());
+        }
+        // Empty levels may have no directory.
+        auto level_no = static_cast<size_t>(atoll(level.path().filename().c_str()));
+        while (view->size() < level_no) {
+            view->push_back(DiskViewLevel{});
         }
-        diskView.push_back(std::move(new_view_level));
+        view->push_back(std::move(new_view_level));
     }
+    return view;
+}
+
+CuckooFilter DiskTable::loadKeyFilter(const DiskView &view) {
+    /*
+     * keys.filter is written on exit along with SSTableClock of that time and removed once it's read,
+     * so that a filter missing keys of sstables written after it, by a run which didn't exit normally, is never used.
+     */
+    auto filter_file = db_home / "keys.filter";
+    if (!exists(filter_file)) {
+        return buildKeyFilter(view);
+    }
+    auto filter = CuckooFilter{};
+    size_t clock = 0;
+    {
+        auto filter_is = create_binary_ifstream(filter_file);
+        bytes_read(filter_is, &clock);
+        filter_is >> filter;
+        if (!filter_is || clock != SSTableClock) {
+            filter = buildKeyFilter(view);
+        }
+    }
+    remove(filter_file);
+    return filter;
 }
 
 DiskTable::~DiskTable() {
-    auto clock_os = create_binary_ofstream(db_home / "sstable.lock");
-    bytes_write(clock_os, &SSTableClock); // Sync SSTableClock to disk when exit.
+    // Victim of a full filter is not saved, a filter without it would miss its key, so it's rebuilt on open.
+    if (keys != nullptr && !keys->full()) {
+        auto filter_os = create_binary_ofstream(db_home / "keys.filter");
+        bytes_write(filter_os, &SSTableClock);
+        keys->save(filter_os);
+    }
+    remove(db_home / "RUNNING");
+    if (options.rate_limiter != nullptr) {
+        options.rate_limiter->tune(this, 0);
+    }
+    delete policy;
 }
 
 
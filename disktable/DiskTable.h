@@ -5,32 +5,83 @@
 #ifndef LSMTREE_DISKTABLE_H
 #define LSMTREE_DISKTABLE_H
 
-#include "../bloom_filter/BloomFilter.h"
+#include "../bloom_filter/SSTableFilter.h"
+#include "../bloom_filter/CuckooFilter.h"
 #include "sstable/SSTable.h"
+#include "RestartIndex.h"
+#include "BlockCache.h"
+#include "Manifest.h"
+#include "RateLimiter.h"
 #include "../memtable/MemTable.h"
-#include <map>
 #include <list>
 #include <algorithm>
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <map>
+#include <set>
+#include <atomic>
 
 class DiskTableNode {
 protected:
-    using Filter=BloomFilter<long long>;
-    using IndexMap=std::map<long long, size_t>;
+    using Filter=SSTableFilter;
+    using IndexMap=RestartIndex;
 
     SSTable *_sstable;
     Filter *filter;
     IndexMap *index;
-
+    LearnedIndex *learned; // If sstable has a learned index, index is not loaded at all.
+    RangeFilter *rangeFilter; // nullptr if sstable has no range filter.
+    // Top level index of partitioned index and filter, nullptr if they are not partitioned.
+    // Then neither filter nor index is loaded, partitions are read on demand into blockCache.
+    PartitionedSSTableFilter::Head *partitions;
+    RangeTombstones *rangeTombstones = nullptr; // Loaded on first access, if sstable has any.
+    std::shared_ptr<BlockCache> blockCache;
+    uint64_t cache_owner;
+
+    // Metadata is loaded lazily on first access, which may come from several readers at the same time.
+    std::once_flag header_once, filter_once, index_once, range_tombstones_once;
+    std::atomic<size_t> metadata_bytes{0}; // Bytes of filter and indexes loaded so far.
+    bool obsolete = false;
+    // Known without reading header if node is opened from a manifest record.
+    bool range_known = false;
+    long long key_min = 0;
+    long long key_max = 0;
+    size_t file_size = 0;
+    // Known for sstables written since manifest records them, 0 otherwise.
+    size_t entries = 0;
+    size_t tombstones = 0;
 
     void loadIndexFilter();
 
+    void loadIndex();
+
+    struct RestartInterval {
+        bool valid;
+        size_t offset;
+        size_t end_offset;
+    };
+
+    // Restart interval where key would be, invalid if key is less than key_min.
+    RestartInterval restartOf(long long key);
+
+    template<typename T, typename Load>
+    std::shared_ptr<const T> cachedBlock(uint64_t offset, Load load);
+
+    std::shared_ptr<const SSTableFilter> filterPartition(size_t p);
+
+    // Restart points of partition p, followed by first restart point of partition p + 1 if any.
+    std::shared_ptr<const SSTableIndex> indexPartition(size_t p);
+
 public:
-    DiskTableNode();
+    explicit DiskTableNode(std::shared_ptr<BlockCache> cache = nullptr);
 
     DiskTableNode(DiskTableNode &&rhs) noexcept;
 
-    explicit DiskTableNode(const path &p);
+    explicit DiskTableNode(const path &p, std::shared_ptr<BlockCache> cache = nullptr);
+
+    DiskTableNode(const path &p, const ManifestFile &f, std::shared_ptr<BlockCache> cache = nullptr);
 
     ~DiskTableNode();
 
@@ -46,46 +97,193 @@ public:
 
     SSTableDataEntry getEntry(long long key);
 
+    // Entries with key in [lo, hi], tombstones included.
+    SSTableData getRange(long long lo, long long hi);
+
+    // False if no key of sstable is in [lo, hi], by key_min/key_max and range filter.
+    bool mightInRange(long long lo, long long hi);
+
     bool hasKey(long long key);
 
     bool intersect(DiskTableNode &rhs);
 
-    bool intersect(SSTableData &rhs);
+    // Whether key range of sstable overlaps keys of rhs or its range tombstones, tombstones of sstable included.
+    bool intersect(SSTableData &rhs, const RangeTombstones &rhs_tombstones);
 
     bool valid(const SSTableDataEntry &s);
 
-    void fillData(SSTableData &new_data);
+    void fillData(SSTableData &new_data, const Options &options = Options{});
 
     void clearDataCache();
 
-    void fillData(SSTableData &&new_data);
+    void fillData(SSTableData &&new_data, const Options &options = Options{}, RangeTombstones &&range_tombstones = {});
 
-    void writeToDisk(const path &&dst_file);
+    void writeToDisk(const path &&dst_file, bool sync = false, const SSTable::WriteThrottle &throttle = nullptr);
 
     void removeFromDisk();
 
+    // Remove sstable file once the last version referencing this node is released.
+    void markObsolete();
+
+    // Load header, filter and index now instead of on first access.
+    void warmUp();
+
+    // Memory taken by filter and indexes loaded, partitions in block cache excluded.
+    size_t metadataBytes() const;
+
     path getFile();
+
+    // SSTableClock when sstable was written, which is its filename.
+    size_t number();
+
+    size_t fileSize();
+
+    size_t entriesCount() const;
+
+    size_t tombstonesCount() const;
+
+    size_t rangeTombstonesCount();
+
+    // Coalesced, see coalesce_range_tombstones.
+    const RangeTombstones &getRangeTombstones();
+
+    // Whether a range tombstone of sstable covers key, hiding it in older sstables.
+    bool rangeDeleted(long long key);
+
+    // Key range from manifest record or header, covering range tombstones as well.
+    std::pair<long long, long long> keyRange();
+
+    ManifestFile manifestFile(size_t level);
 };
 
 
-class DiskTable {
+/*
+ * One filter over keys of every sstable of a DiskTable, so that a key absent from disk is answered
+ * by a single probe instead of a bloom filter probe and an index lookup per sstable.
+ * Keys are only added, a key whose tombstone is dropped by compaction stays as a false positive
+ * until filter gets full and is rebuilt from sstables.
+ */
+class DiskKeyFilter {
 private:
-    using DiskViewLevel=std::list<DiskTableNode>;
+    std::shared_mutex mutex;
+    CuckooFilter filter;
+
+public:
+    explicit DiskKeyFilter(CuckooFilter &&filter);
+
+    bool mightContain(long long key);
+
+    // Return false if filter gets full, it still holds every key added, but should be replaced by a larger one.
+    bool add(const SSTableData &data);
+
+    void replace(CuckooFilter &&new_filter);
+
+    bool full();
+
+    // Filter must not be full, see CuckooFilter.
+    void save(std::ostream &os);
+};
+
+struct Compaction;
+
+class CompactionPolicy;
+
+class DiskTable {
+public:
+    using DiskTableNodePtr=std::shared_ptr<DiskTableNode>;
+    using DiskViewLevel=std::list<DiskTableNodePtr>;
     using DiskView=std::vector<DiskViewLevel>;
+    // An immutable snapshot of sstables of every level. Compaction builds a new one instead of modifying
+    // the one readers may hold, nodes dropped by compaction are removed from disk when the last snapshot
+    // referencing them is released.
+    using Version=std::shared_ptr<const DiskView>;
+    using KeyFilterPtr=std::shared_ptr<DiskKeyFilter>;
+private:
     using DiskViewLevelIter=DiskView::iterator;
     using DataIter=SSTableData::iterator;
     using MergeSeq=std::pair<DataIter, DataIter>;
     using DiskNodeIter=DiskViewLevel::iterator;
-    DiskView diskView;
-    size_t SSTableClock;
+    Version diskView; // Always accessed by std::atomic_load/std::atomic_store.
+    size_t SSTableClock; // Guarded by clock_mutex.
+    std::mutex clock_mutex;
+    std::mutex install_mutex; // Serialize building and installing versions between persistent and compactOnce.
     path db_home;
 
     template<typename ...Datas>
     SSTableData merge(Datas ...datas);
 
-    const int LEVEL0_LIMIT = 2;
-    const int LEVEL_FACTOR = 2;
-    const int SSTABLE_SIZE_LIMIT = 2 * 1000 * 1000; // 2 MB(not MiB)
+    Options options;
+    bool background_compaction; // Compaction is left to compactOnce instead of being run by persistent.
+    Manifest manifest;
+    std::shared_ptr<BlockCache> blockCache;
+    KeyFilterPtr keys; // Only if options.key_filter is true.
+
+    // Add keys of all sstables in view to a new filter sized for them.
+    static CuckooFilter buildKeyFilter(const DiskView &view);
+
+    CuckooFilter loadKeyFilter(const DiskView &view);
+
+    // Remove files of level directories not in levels: sstables written by a persistent whose manifest record
+    // never completed, sstables whose removal was recorded but not done, and temporary files.
+    void removeOrphans(const Manifest::Levels &levels);
+
+    // Build diskView by scanning level directories, for a db_dir written before manifest was introduced.
+    std::shared_ptr<DiskView> scanLevels();
+
+    std::shared_ptr<DiskView> replayManifest(const Manifest::Levels &levels);
+
+    static Manifest::Levels manifestLevels(const DiskView &view);
+
+    // options with values out of range clamped into it, DiskTable and its policy only see these.
+    static Options sanitized(const Options &options);
+
+    // Warm up every node of view on options.warm_up_threads threads.
+    void warmUp(const DiskView &view);
+
+    // Log edit to manifest and make view current, then mark nodes it removes obsolete. Caller holds install_mutex.
+    void install(const std::shared_ptr<DiskView> &view, VersionEdit &edit, bool keys_full,
+                 const DiskViewLevel &obsolete);
+
+    // Options to write an sstable into level with, filter bits are set for level if filter_bits_per_level is on.
+    Options optionsOfLevel(size_t level, size_t levels) const;
+
+    CompactionPolicy *policy;
+
+    // Merge inputs of compaction into output level. Work done is bounded by sstables involved, not by size of levels.
+    // Nodes merged are added to obsolete, for install to mark once edit is logged.
+    void compact(DiskView &view, Compaction &compaction, VersionEdit &edit, DiskViewLevel &obsolete);
+
+    // Whether no sstable left in output level or below may hold a key in [lo, hi], so that tombstones of keys
+    // in [lo, hi] written into output level hide nothing and can be dropped.
+    static bool bottommost(const DiskView &view, const Compaction &compaction, long long lo, long long hi);
+
+    // Whether inputs of compaction overlap neither each other nor sstables of output level they would be merged with,
+    // so that they can be moved into output level as they are.
+    static bool canMove(Compaction &compaction, DiskViewLevel &into);
+
+    // Move node into level without rewriting it. It keeps filter and index it was written with.
+    // Node is added to obsolete, its old name is removed only after install has logged edit.
+    void moveFile(DiskView &view, size_t level, DiskTableNodePtr &node, VersionEdit &edit, DiskViewLevel &obsolete);
+
+    // Drop entries of data covered by deleted.
+    static void dropRangeDeleted(SSTableData &data, const RangeTombstones &deleted);
+
+    // Split data into sstables of options.sstable_size and add them to level. Every sstable takes the part of
+    // tombstones between its first key and first key of the next one, so sstables written don't overlap.
+    void writeLevel(DiskView &view, size_t level, SSTableData &data, const RangeTombstones &tombstones,
+                    VersionEdit &edit);
+
+    path newFileName(size_t level);
+
+    // Take bytes read from options.rate_limiter, if any, before they are read. A file is charged as a whole.
+    void chargeIO(size_t bytes, RateLimiter::Priority priority);
+
+    // Charges options.rate_limiter for every block of an sstable before it's written, nullptr without a limiter.
+    // Flushes are charged at high priority, compaction at low.
+    SSTable::WriteThrottle throttleOf(RateLimiter::Priority priority);
+
+    // Report compaction debt of view to options.rate_limiter, if any.
+    void tuneRateLimiter(const DiskView &view);
 
 public:
     using QueryResult=struct {
@@ -93,13 +291,53 @@ public:
         std::string data;
     };
 
-    explicit DiskTable(path &db_dir);
+    // Sstables written are numbered after clock_floor, so that a DiskTable replacing another one in db_dir never
+    // reuses a number of a file that readers of the old one may still remove.
+    explicit DiskTable(path &db_dir, const Options &options = Options{}, size_t clock_floor = 0);
 
     ~DiskTable();
 
     QueryResult get(long long int key);
 
-    void persistent(MemTable &&m, bool df = false);
+    // Merge entries found are folded by merge_operator into the value they apply to.
+    static QueryResult get(const Version &version, long long int key, const MergeOperator &merge_operator = nullptr);
+
+    // Add entries with key in [lo, hi] to result by addScanned, unless they are covered by deleted.
+    // Sstables are visited from newest to oldest, so an entry only shadows older ones, range tombstones of
+    // an sstable are added to deleted after its entries.
+    static void scan(const Version &version, long long lo, long long hi, std::map<long long, SSTableDataEntry> &result,
+                     RangeTombstones &deleted, const MergeOperator &merge_operator = nullptr);
+
+    // Add entry to result of a scan unless an entry of its key is there already, entries are added from newest
+    // to oldest. A merge entry in result is combined with older entries of its key, see merge_entries.
+    static void addScanned(std::map<long long, SSTableDataEntry> &result, SSTableDataEntry &&entry,
+                           const MergeOperator &merge_operator);
+
+    Version current();
+
+    // SSTableClock, number of the sstable written last.
+    size_t clock();
+
+    // nullptr if key filter is disabled. The filter object lives as long as the DiskTable, readers holding
+    // the pointer see every key of any version installed before.
+    KeyFilterPtr keyFilter();
+
+    std::shared_ptr<BlockCache> getBlockCache();
+
+    // Sum of DiskTableNode::metadataBytes of current version.
+    size_t metadataBytes();
+
+    // Bloom filter bits per key of sstables written into level, when there are levels levels.
+    double filterBitsPerKey(size_t level, size_t levels) const;
+
+    // Write m into level 0 and install it. Then run compaction until policy picks none, unless options.rate_limiter
+    // is set: throttled compaction is left to compactOnce, so that it never holds a flush back.
+    // Not thread-safe, callers should serialize writes. Readers are never blocked.
+    void persistent(MemTable &m, bool df = false);
+
+    // Run one compaction picked from current version and install it, return false if none is needed.
+    // Only called by a single compaction thread, it may run along with persistent.
+    bool compactOnce();
 };
 
 template<typename... Datas>
@@ -150,15 +388,31 @@ SSTableData DiskTable::merge(Datas... datas) {
                 merge_resolution = *seq2;
             }
         }
-        std::for_each(merge_seqs.begin(), merge_seqs.end(), [merge_resolution](MergeSeq &seq) {
-            if (seq.first->key == merge_resolution.first->key && seq.first != seq.second) {
-                ++seq.first;
-            }
-        });
         if (merge_resolution.first == merge_resolution.second) {
             break;
         }
-        merge_result.push_back(*merge_resolution.first);
+        auto resolved = *merge_resolution.first;
+        if (resolved.merge_flag) {
+            // A merge entry takes entries of its key it takes precedence over, in the order it does.
+            auto older = std::vector<const SSTableDataEntry *>{};
+            for (const auto &seq:merge_seqs) {
+                if (seq.first != seq.second && seq.first->key == resolved.key && &*seq.first != &*merge_resolution.first) {
+                    older.push_back(&*seq.first);
+                }
+            }
+            std::stable_sort(older.begin(), older.end(), [](const SSTableDataEntry *a, const SSTableDataEntry *b) {
+                return a->timestamp > b->timestamp;
+            });
+            for (auto p = older.begin(); p != older.end() && resolved.merge_flag; p++) {
+                merge_entries(options.merge_operator, resolved, *p);
+            }
+        }
+        std::for_each(merge_seqs.begin(), merge_seqs.end(), [&resolved](MergeSeq &seq) {
+            if (seq.first != seq.second && seq.first->key == resolved.key) {
+                ++seq.first;
+            }
+        });
+        merge_result.push_back(std::move(resolved));
     }
     return merge_result;
 }
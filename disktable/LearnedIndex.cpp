@@ -0,0 +1,100 @@
+#include "LearnedIndex.h"
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+static double distance(long long from, long long to) {
+    // to >= from, take difference in unsigned arithmetic to avoid overflow on wide key ranges.
+    return static_cast<double>(static_cast<uint64_t>(to) - static_cast<uint64_t>(from));
+}
+
+LearnedIndex::LearnedIndex(const std::vector<long long> &keys, size_t epsilon) : epsilon(epsilon),
+                                                                                  points(keys.size()) {
+    auto eps = static_cast<double>(epsilon);
+    size_t start = 0;
+    while (start < keys.size()) {
+        auto slope_low = -std::numeric_limits<double>::infinity();
+        auto slope_high = std::numeric_limits<double>::infinity();
+        auto end = start + 1;
+        for (; end < keys.size(); end++) {
+            auto dx = distance(keys[start], keys[end]);
+            auto dy = static_cast<double>(end - start);
+            auto low = std::max(slope_low, (dy - eps) / dx);
+            auto high = std::min(slope_high, (dy + eps) / dx);
+            if (low > high) {
+                break;
+            }
+            slope_low = low;
+            slope_high = high;
+        }
+        auto slope = 0.0;
+        if (end - start > 1) {
+            // Upper bound of the cone is always positive, so clamping to 0 stays inside the cone,
+            // and keeps prediction monotone.
+            slope = std::max(0.0, (slope_low + slope_high) / 2);
+        }
+        segments.push_back({keys[start], start, slope});
+        start = end;
+    }
+}
+
+std::pair<size_t, size_t> LearnedIndex::search(long long key) const {
+    if (segments.empty() || key < segments.front().first_key) {
+        return {0, 0};
+    }
+    auto next = std::upper_bound(segments.begin(), segments.end(), key,
+                                 [](long long k, const Segment &s) { return k < s.first_key; });
+    auto &seg = *std::prev(next);
+    auto last_pos = next == segments.end() ? points - 1 : next->first_pos - 1;
+    auto predicted = static_cast<double>(seg.first_pos) + seg.slope * distance(seg.first_key, key);
+    // Keys after last point of a segment are clamped to that point, which is their floor.
+    auto pos = std::min(static_cast<double>(last_pos), predicted);
+    auto p = static_cast<size_t>(pos + 0.5);
+    auto first = p > epsilon + 1 ? p - epsilon - 1 : 0;
+    first = std::max(first, seg.first_pos);
+    auto last = std::min(p + epsilon + 1, last_pos);
+    return {first, last};
+}
+
+size_t LearnedIndex::segmentsCount() const {
+    return segments.size();
+}
+
+size_t LearnedIndex::size_bytes() const {
+    return 3 * sizeof(uint64_t) + segments.size() * (sizeof(long long) + sizeof(uint64_t) + sizeof(double));
+}
+
+std::ostream &operator<<(std::ostream &os, const LearnedIndex &l) {
+    uint64_t count = l.segments.size(), epsilon = l.epsilon, points = l.points;
+    os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    os.write(reinterpret_cast<const char *>(&epsilon), sizeof(epsilon));
+    os.write(reinterpret_cast<const char *>(&points), sizeof(points));
+    for (const auto &s:l.segments) {
+        uint64_t first_pos = s.first_pos;
+        os.write(reinterpret_cast<const char *>(&s.first_key), sizeof(s.first_key));
+        os.write(reinterpret_cast<const char *>(&first_pos), sizeof(first_pos));
+        os.write(reinterpret_cast<const char *>(&s.slope), sizeof(s.slope));
+    }
+    return os;
+}
+
+std::istream &operator>>(std::istream &is, LearnedIndex &l) {
+    uint64_t count = 0, epsilon = 0, points = 0;
+    is.read(reinterpret_cast<char *>(&count), sizeof(count));
+    is.read(reinterpret_cast<char *>(&epsilon), sizeof(epsilon));
+    is.read(reinterpret_cast<char *>(&points), sizeof(points));
+    l.epsilon = epsilon;
+    l.points = points;
+    l.segments.clear();
+    l.segments.reserve(count);
+    for (uint64_t i = 0; i < count; i++) {
+        auto s = LearnedIndex::Segment{};
+        uint64_t first_pos = 0;
+        is.read(reinterpret_cast<char *>(&s.first_key), sizeof(s.first_key));
+        is.read(reinterpret_cast<char *>(&first_pos), sizeof(first_pos));
+        is.read(reinterpret_cast<char *>(&s.slope), sizeof(s.slope));
+        s.first_pos = first_pos;
+        l.segments.push_back(s);
+    }
+    return is;
+}
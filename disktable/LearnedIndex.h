@@ -0,0 +1,47 @@
+#ifndef LSMTREE_LEARNEDINDEX_H
+#define LSMTREE_LEARNEDINDEX_H
+
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <cstddef>
+
+/*
+ * Piecewise-linear model mapping a key to position of the last restart point not greater than it.
+ * Built in one pass over sorted restart keys with the shrinking cone algorithm, every restart key
+ * is predicted within epsilon of its real position, so lookup just searches a window of 2 * (epsilon + 1) + 1
+ * restart points around the prediction.
+ */
+class LearnedIndex {
+private:
+    struct Segment {
+        long long first_key;
+        size_t first_pos;
+        double slope;
+    };
+
+    std::vector<Segment> segments;
+    size_t epsilon = 0;
+    size_t points = 0;
+public:
+    LearnedIndex() = default;
+
+    LearnedIndex(const std::vector<long long> &keys, size_t epsilon);
+
+    // Window [first, last] of restart points containing floor of key.
+    [[nodiscard]] std::pair<size_t, size_t> search(long long key) const;
+
+    [[nodiscard]] size_t segmentsCount() const;
+
+    // Bytes taken by the learned index when serialized.
+    [[nodiscard]] size_t size_bytes() const;
+
+    // Layout: segments count(8 bytes), epsilon(8 bytes), points(8 bytes), then every segment as
+    // first_key(8 bytes), first_pos(8 bytes), slope(8 bytes).
+    friend std::ostream &operator<<(std::ostream &os, const LearnedIndex &l);
+
+    friend std::istream &operator>>(std::istream &is, LearnedIndex &l);
+};
+
+
+#endif //LSMTREE_LEARNEDINDEX_H
@@ -0,0 +1,184 @@
+#include "Manifest.h"
+#include "sstable/SSTable.h"
+#include "../bloom_filter/Murmur.h"
+#include <sstream>
+#include <map>
+
+static const size_t MANIFEST_REWRITE_MIN_ITEMS = 1024;
+
+std::ostream &operator<<(std::ostream &os, const VersionEdit &e) {
+    bytes_write(os, &e.clock);
+    bytes_write(os, &e.levels);
+    auto added = e.added.size();
+    bytes_write(os, &added);
+    for (const auto &f:e.added) {
+        bytes_write(os, &f.level);
+        bytes_write(os, &f.number);
+        bytes_write(os, &f.key_min);
+        bytes_write(os, &f.key_max);
+        bytes_write(os, &f.file_size);
+    }
+    auto removed = e.removed.size();
+    bytes_write(os, &removed);
+    for (auto number:e.removed) {
+        bytes_write(os, &number);
+    }
+    // Appended after fields above, records written before them end here.
+    for (const auto &f:e.added) {
+        bytes_write(os, &f.entries);
+        bytes_write(os, &f.tombstones);
+    }
+    return os;
+}
+
+std::istream &operator>>(std::istream &is, VersionEdit &e) {
+    size_t added = 0, removed = 0;
+    bytes_read(is, &e.clock);
+    bytes_read(is, &e.levels);
+    bytes_read(is, &added);
+    e.added.clear();
+    for (size_t i = 0; i < added && is; i++) {
+        auto f = ManifestFile{};
+        bytes_read(is, &f.level);
+        bytes_read(is, &f.number);
+        bytes_read(is, &f.key_min);
+        bytes_read(is, &f.key_max);
+        bytes_read(is, &f.file_size);
+        e.added.push_back(f);
+    }
+    bytes_read(is, &removed);
+    e.removed.clear();
+    for (size_t i = 0; i < removed && is; i++) {
+        size_t number = 0;
+        bytes_read(is, &number);
+        e.removed.push_back(number);
+    }
+    if (is && is.peek() != std::char_traits<char>::eof()) {
+        for (auto &f:e.added) {
+            bytes_read(is, &f.entries);
+            bytes_read(is, &f.tombstones);
+        }
+    }
+    return is;
+}
+
+Manifest::Manifest(path file, bool sync) : file(std::move(file)), sync(sync) {
+}
+
+bool Manifest::exists() const {
+    return std::filesystem::exists(file);
+}
+
+bool Manifest::replay(Manifest::Levels &levels, size_t &clock) {
+    if (!exists()) {
+        return false;
+    }
+    auto live = std::map<size_t, ManifestFile>{}; // Numbers grow with time, so files of a level are in adding order.
+    size_t levels_count = 1;
+    size_t valid_bytes = 0;
+    auto log_bytes = file_size(file);
+    items = 0;
+    {
+        auto is = create_binary_ifstream(file);
+        while (true) {
+            uint32_t length = 0;
+            uint64_t checksum = 0;
+            bytes_read(is, &length);
+            bytes_read(is, &checksum);
+            // Length of a torn or corrupt record may claim more than the log holds, checksum can't be trusted yet.
+            if (!is || length > log_bytes - valid_bytes - sizeof(length) - sizeof(checksum)) {
+                break;
+            }
+            auto payload = std::string(length, '\0');
+            if (!is.read(payload.data(), length) || MurmurHash64A(payload.data(), length, 0) != checksum) {
+                break;
+            }
+            auto edit = VersionEdit{};
+            auto edit_is = std::istringstream{std::move(payload)};
+            if (!(edit_is >> edit)) {
+                break;
+            }
+            // An edit may remove a file it adds, when it's compacted by the same persistent.
+            for (const auto &f:edit.added) {
+                live[f.number] = f;
+            }
+            for (auto number:edit.removed) {
+                live.erase(number);
+            }
+            clock = edit.clock;
+            levels_count = edit.levels;
+            items += edit.added.size() + edit.removed.size() + 1;
+            valid_bytes += sizeof(length) + sizeof(checksum) + length;
+        }
+    }
+    if (log_bytes > valid_bytes) {
+        // Drop torn record, or records appended later would be unreachable behind it.
+        resize_file(file, valid_bytes);
+    }
+    levels.assign(levels_count, {});
+    for (const auto &[number, f]:live) {
+        if (f.level >= levels.size()) {
+            levels.resize(f.level + 1);
+        }
+        levels[f.level].push_back(f);
+    }
+    return true;
+}
+
+void Manifest::appendRecord(const VersionEdit &edit) {
+    auto edit_os = std::ostringstream{};
+    edit_os << edit;
+    auto payload = edit_os.str();
+    uint32_t length = payload.size();
+    uint64_t checksum = MurmurHash64A(payload.data(), length, 0);
+    bytes_write(log, &length);
+    bytes_write(log, &checksum);
+    log.write(payload.data(), length);
+    log.flush();
+    if (log.fail()) {
+        // Log is left failed, so later records never follow a torn one, which would end replay before them.
+        throw SyncFailedException();
+    }
+    items += edit.added.size() + edit.removed.size() + 1;
+}
+
+void Manifest::append(const VersionEdit &edit) {
+    if (!log.is_open()) {
+        log.open(file, ios_base::out | ios_base::binary | ios_base::app);
+    }
+    appendRecord(edit);
+    if (sync) {
+        sync_path(file);
+    }
+}
+
+void Manifest::rewrite(const Manifest::Levels &levels, size_t clock) {
+    auto edit = VersionEdit{clock, std::max<size_t>(levels.size(), 1), {}, {}};
+    for (const auto &level:levels) {
+        edit.added.insert(edit.added.end(), level.begin(), level.end());
+    }
+    auto tmp_file = path{file}.concat(".tmp");
+    if (log.is_open()) {
+        log.close();
+    }
+    log = create_binary_ofstream(tmp_file);
+    items = 0;
+    appendRecord(edit);
+    log.close();
+    if (log.fail()) {
+        throw SyncFailedException();
+    }
+    if (sync) {
+        sync_path(tmp_file);
+    }
+    // Rename replaces old log atomically, a crash leaves either old log or new one.
+    rename(tmp_file, file);
+    if (sync) {
+        sync_path(file.parent_path());
+    }
+    log.open(file, ios_base::out | ios_base::binary | ios_base::app);
+}
+
+bool Manifest::shouldRewrite(size_t live_files) const {
+    return items > 2 * live_files + MANIFEST_REWRITE_MIN_ITEMS;
+}
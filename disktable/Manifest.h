@@ -0,0 +1,72 @@
+#ifndef LSMTREE_MANIFEST_H
+#define LSMTREE_MANIFEST_H
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <cstdint>
+
+using namespace std::filesystem;
+
+// An sstable as recorded in manifest, file of it is db_dir/level/number.bin.
+struct ManifestFile {
+    size_t level;
+    size_t number;
+    long long key_min;
+    long long key_max;
+    size_t file_size;
+    size_t entries; // 0 if unknown, for a file recorded before these were.
+    size_t tombstones;
+};
+
+// Changes made to sstables by one DiskTable::persistent.
+struct VersionEdit {
+    size_t clock; // SSTableClock after the edit.
+    size_t levels; // Count of levels after the edit, including empty ones.
+    std::vector<ManifestFile> added;
+    std::vector<size_t> removed; // Numbers of removed files, numbers are unique across levels. Applied after added.
+
+    friend std::ostream &operator<<(std::ostream &os, const VersionEdit &e);
+
+    friend std::istream &operator>>(std::istream &is, VersionEdit &e);
+};
+
+/*
+ * Log of VersionEdit, so that sstables of a DiskTable are known at startup without scanning level directories
+ * and without reading headers of sstables for their key range.
+ * Every record is length and checksum of an edit followed by the edit. A record torn by a crash ends replay,
+ * as the edit it holds never took effect.
+ * Log grows with every persistent, it's rewritten as a single edit adding every live file once it gets much
+ * longer than that.
+ */
+class Manifest {
+private:
+    path file;
+    std::ofstream log;
+    bool sync; // fsync log after every record.
+    size_t items = 0;
+
+    void appendRecord(const VersionEdit &edit);
+
+public:
+    using Levels=std::vector<std::vector<ManifestFile>>;
+
+    explicit Manifest(path file, bool sync = false);
+
+    bool exists() const;
+
+    // Replay log into files of every level, files of a level are ordered as they were added.
+    // Return false if there is no manifest.
+    bool replay(Levels &levels, size_t &clock);
+
+    void append(const VersionEdit &edit);
+
+    // Replace log by one edit adding every file of levels.
+    void rewrite(const Levels &levels, size_t clock);
+
+    // Whether log is long enough to be rewritten, given live files count.
+    bool shouldRewrite(size_t live_files) const;
+};
+
+
+#endif //LSMTREE_MANIFEST_H
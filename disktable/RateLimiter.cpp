@@ -0,0 +1,76 @@
+#include "RateLimiter.h"
+#include <algorithm>
+
+RateLimiter::RateLimiter(size_t bytes_per_second, bool auto_tuned)
+        : max_bytes_per_second(std::max(bytes_per_second, RATE_LIMITER_AUTO_TUNE_MIN_FRACTION)),
+          auto_tuned(auto_tuned), last_refill(Clock::now()) {
+    this->bytes_per_second = auto_tuned ? max_bytes_per_second / RATE_LIMITER_AUTO_TUNE_MIN_FRACTION
+                                        : max_bytes_per_second;
+}
+
+size_t RateLimiter::burst() const {
+    return std::max<size_t>(bytes_per_second / RATE_LIMITER_REFILLS_PER_SECOND, 1);
+}
+
+void RateLimiter::refill() {
+    auto now = Clock::now();
+    available += std::chrono::duration<double>(now - last_refill).count() * bytes_per_second;
+    available = std::min(available, static_cast<double>(burst()));
+    last_refill = now;
+}
+
+void RateLimiter::request(size_t bytes, RateLimiter::Priority priority) {
+    std::unique_lock lock{mutex};
+    total_bytes += bytes;
+    auto high = priority == Priority::High;
+    if (high) {
+        waiting_high++;
+    }
+    while (bytes > 0) {
+        if (!high && waiting_high > 0) {
+            cv.wait(lock); // Woken up once high priority requests are done.
+            continue;
+        }
+        refill();
+        auto chunk = std::min(bytes, burst());
+        if (available >= chunk) {
+            available -= chunk;
+            bytes -= chunk;
+            continue;
+        }
+        cv.wait_for(lock, std::chrono::duration<double>((chunk - available) / bytes_per_second));
+    }
+    if (high && --waiting_high == 0) {
+        cv.notify_all();
+    }
+}
+
+void RateLimiter::tune(const void *owner, size_t compaction_debt) {
+    if (!auto_tuned) {
+        return;
+    }
+    std::lock_guard lock{mutex};
+    if (compaction_debt == 0) {
+        debts.erase(owner);
+    } else {
+        debts[owner] = compaction_debt;
+    }
+    size_t total_debt = 0;
+    for (const auto &[o, debt]:debts) {
+        total_debt += debt;
+    }
+    refill(); // Bytes accumulated so far are at the old rate.
+    bytes_per_second = std::clamp(total_debt / RATE_LIMITER_AUTO_TUNE_HORIZON,
+                                  max_bytes_per_second / RATE_LIMITER_AUTO_TUNE_MIN_FRACTION, max_bytes_per_second);
+    cv.notify_all();
+}
+
+size_t RateLimiter::bytesPerSecond() {
+    std::lock_guard lock{mutex};
+    return bytes_per_second;
+}
+
+size_t RateLimiter::totalBytes() {
+    std::lock_guard lock{mutex};
+    return total_bytes;
+}
@@ -0,0 +1,68 @@
+#ifndef LSMTREE_RATELIMITER_H
+#define LSMTREE_RATELIMITER_H
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <map>
+#include <cstddef>
+
+const size_t RATE_LIMITER_REFILLS_PER_SECOND = 10;
+
+const size_t RATE_LIMITER_AUTO_TUNE_MIN_FRACTION = 10;
+
+const size_t RATE_LIMITER_AUTO_TUNE_HORIZON = 10; // Seconds.
+
+/*
+ * Token bucket bounding bytes read and written by flushes and compaction of every DiskTable it's given to,
+ * so that background I/O leaves the device to foreground reads. Gets and scans are never limited.
+ * Bucket refills continuously and holds at most 1 / RATE_LIMITER_REFILLS_PER_SECOND of a second of bytes,
+ * so I/O is spread evenly instead of in bursts, a request larger than that is granted in several chunks.
+ * High priority requests (flushes) are granted before any waiting low priority one (compaction), so a flush never
+ * queues behind compaction, though its bytes are still taken from the bucket.
+ * Auto tuned, rate is the one repaying compaction debt reported by DiskTables in RATE_LIMITER_AUTO_TUNE_HORIZON
+ * seconds, at least 1 / RATE_LIMITER_AUTO_TUNE_MIN_FRACTION of bytes_per_second and at most bytes_per_second.
+ * Compaction slows down while little is pending and catches up once it falls behind.
+ */
+class RateLimiter {
+public:
+    enum class Priority {
+        Low, High
+    };
+
+private:
+    using Clock=std::chrono::steady_clock;
+
+    std::mutex mutex;
+    std::condition_variable cv; // Notified when rate changes or a high priority request is done.
+    size_t max_bytes_per_second;
+    bool auto_tuned;
+    size_t bytes_per_second;
+    double available = 0;
+    Clock::time_point last_refill;
+    size_t waiting_high = 0;
+    size_t total_bytes = 0;
+    std::map<const void *, size_t> debts; // Compaction debt by DiskTable.
+
+    void refill();
+
+    [[nodiscard]] size_t burst() const;
+
+public:
+    explicit RateLimiter(size_t bytes_per_second, bool auto_tuned = false);
+
+    // Block until bytes may be read or written at priority.
+    void request(size_t bytes, Priority priority);
+
+    // Record compaction debt of owner, bytes it expects compaction to rewrite, and retune rate by debt of all owners.
+    // No effect unless auto tuned. An owner reports 0 once it's gone.
+    void tune(const void *owner, size_t compaction_debt);
+
+    size_t bytesPerSecond();
+
+    // Bytes requested so far.
+    size_t totalBytes();
+};
+
+
+#endif //LSMTREE_RATELIMITER_H
@@ -0,0 +1,62 @@
+#include "RestartIndex.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+#endif
+
+void RestartIndex::push_back(long long key, size_t offset) {
+    keys.push_back(key);
+    offsets.push_back(offset);
+}
+
+void RestartIndex::reserve(size_t n) {
+    keys.reserve(n);
+    offsets.reserve(n);
+}
+
+size_t RestartIndex::size() const {
+    return keys.size();
+}
+
+bool RestartIndex::empty() const {
+    return keys.empty();
+}
+
+size_t RestartIndex::floor(long long key) const {
+    const size_t LINEAR_WINDOW = 16;
+    const long long *base = keys.data();
+    size_t n = keys.size();
+    if (n == 0 || key < base[0]) {
+        return npos;
+    }
+    // Invariant: base[0] <= key, answer lies in [base, base + n).
+    while (n > LINEAR_WINDOW) {
+        auto half = n / 2;
+        base = base[half] <= key ? base + half : base; // Compiled to cmov, no branch to mispredict.
+        n -= half;
+    }
+    // Count keys not greater than key in the window, answer is the last of them.
+    size_t count = 0, i = 0;
+#ifdef __AVX2__
+    auto target = _mm256_set1_epi64x(key);
+    for (; i + 4 <= n; i += 4) {
+        auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + i));
+        auto greater = _mm256_castsi256_pd(_mm256_cmpgt_epi64(block, target));
+        count += 4 - __builtin_popcount(_mm256_movemask_pd(greater));
+    }
+#endif
+    for (; i < n; i++) {
+        count += base[i] <= key;
+    }
+    return base - keys.data() + count - 1;
+}
+
+long long RestartIndex::keyAt(size_t i) const {
+    return keys[i];
+}
+
+size_t RestartIndex::offsetAt(size_t i) const {
+    return offsets[i];
+}
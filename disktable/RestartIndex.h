@@ -0,0 +1,39 @@
+#ifndef LSMTREE_RESTARTINDEX_H
+#define LSMTREE_RESTARTINDEX_H
+
+#include <vector>
+#include <cstddef>
+
+/*
+ * Index of restart points of a sstable, kept as structure-of-arrays:
+ * keys of restart points in one contiguous sorted array, their file offsets in another.
+ * Lookup only touches the key array, using branchless binary search to narrow down
+ * to a small window, which is then finished by a linear (AVX2 if available) scan.
+ */
+class RestartIndex {
+private:
+    std::vector<long long> keys;
+    std::vector<size_t> offsets;
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    RestartIndex() = default;
+
+    void push_back(long long key, size_t offset);
+
+    void reserve(size_t n);
+
+    [[nodiscard]] size_t size() const;
+
+    [[nodiscard]] bool empty() const;
+
+    // Position of the last restart point whose key is not greater than key, npos if there is none.
+    [[nodiscard]] size_t floor(long long key) const;
+
+    [[nodiscard]] long long keyAt(size_t i) const;
+
+    [[nodiscard]] size_t offsetAt(size_t i) const;
+};
+
+
+#endif //LSMTREE_RESTARTINDEX_H
@@ -4,6 +4,11 @@
 
 #include "SSTable.h"
 #include <iostream>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
 
 template<>
 long long int bytes_write<std::string>(std::ostream &os, const std::string *src, long long int count) {
@@ -22,6 +27,18 @@ long long int bytes_read<std::string>(std::istream &is, std::string *dst, long l
     return count;
 }
 
+void sync_path(const path &p) {
+    auto fd = ::open(p.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw SyncFailedException();
+    }
+    auto synced = ::fsync(fd) == 0;
+    ::close(fd);
+    if (!synced) {
+        throw SyncFailedException();
+    }
+}
+
 std::ifstream create_binary_ifstream(const path &file) {
     return std::ifstream(file, ios_base::in | ios_base::binary);
 }
@@ -30,26 +47,183 @@ std::ofstream create_binary_ofstream(const path &file) {
     return std::ofstream(file, ios_base::out | ios_base::binary);
 }
 
+// Throw if is failed, so that a short read of an sstable never passes for its content.
+static void check_read(const std::istream &is) {
+    if (!is) {
+        throw SSTableReadException();
+    }
+}
+
 size_t size_of_entry(const SSTableDataEntry &s) {
     return sizeof(bool) + sizeof(time_t) + sizeof(long long) + sizeof(size_t) + s.value.length();
 }
 
-std::istream &operator>>(std::istream &is, SSTableDataEntry &s) {
-    bytes_read(is, &s.delete_flag);
-    bytes_read(is, &s.timestamp);
-    bytes_read(is, &s.key);
-    bytes_read(is, &s.value_length);
-    bytes_read(is, &s.value, s.value_length);
-    return is;
+long long int varint_write(std::ostream &os, uint64_t v) {
+    long long bytes = 1;
+    while (v >= 0x80) {
+        os.put(static_cast<char>(v | 0x80));
+        v >>= 7;
+        bytes++;
+    }
+    os.put(static_cast<char>(v));
+    return bytes;
 }
 
-std::ofstream &operator<<(std::ofstream &os, const SSTableDataEntry &s) {
-    bytes_write(os, &s.delete_flag);
-    bytes_write(os, &s.timestamp);
-    bytes_write(os, &s.key);
-    bytes_write(os, &s.value_length);
-    bytes_write(os, &s.value);
-    return os;
+long long int varint_read(std::istream &is, uint64_t *dst) {
+    long long bytes = 0;
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        auto c = is.get();
+        if (c == std::char_traits<char>::eof()) {
+            break;
+        }
+        bytes++;
+        v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            break;
+        }
+    }
+    *dst = v;
+    return bytes;
+}
+
+size_t varint_length(uint64_t v) {
+    size_t bytes = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+bool varint_decode(const char *&p, const char *end, uint64_t *dst) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        auto c = static_cast<unsigned char>(*p++);
+        v |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *dst = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t key_delta(long long key, long long prev_key) {
+    // Keys are sorted ascending, so delta is always non-negative in modular arithmetic.
+    return static_cast<uint64_t>(key) - static_cast<uint64_t>(prev_key);
+}
+
+static const uint64_t ENTRY_MERGE_BIT = static_cast<uint64_t>(1) << 63;
+
+static uint64_t pack_flags(const SSTableDataEntry &s) {
+    return static_cast<uint64_t>(s.timestamp) << 1 | static_cast<uint64_t>(s.delete_flag) |
+           (s.merge_flag ? ENTRY_MERGE_BIT : 0);
+}
+
+size_t encoded_size_of_entry(const SSTableDataEntry &s, long long prev_key) {
+    return varint_length(key_delta(s.key, prev_key)) + varint_length(pack_flags(s)) + varint_length(s.value_length) +
+           s.value.length();
+}
+
+long long int entry_write(std::ostream &os, const SSTableDataEntry &s, long long prev_key) {
+    long long bytes = 0;
+    bytes += varint_write(os, key_delta(s.key, prev_key));
+    bytes += varint_write(os, pack_flags(s));
+    bytes += varint_write(os, s.value_length);
+    bytes += bytes_write(os, &s.value);
+    return bytes;
+}
+
+long long int entry_read_head(std::istream &is, SSTableDataEntry &s, long long prev_key) {
+    long long bytes = 0;
+    uint64_t delta = 0, flags = 0, value_length = 0;
+    bytes += varint_read(is, &delta);
+    bytes += varint_read(is, &flags);
+    bytes += varint_read(is, &value_length);
+    s.key = static_cast<long long>(static_cast<uint64_t>(prev_key) + delta);
+    s.delete_flag = flags & 1;
+    s.merge_flag = (flags & ENTRY_MERGE_BIT) != 0;
+    s.timestamp = static_cast<time_t>((flags & ~ENTRY_MERGE_BIT) >> 1);
+    s.value_length = value_length;
+    return bytes;
+}
+
+bool entry_decode_head(const char *&p, const char *end, SSTableDataEntry &s, long long prev_key) {
+    uint64_t delta = 0, flags = 0, value_length = 0;
+    if (!varint_decode(p, end, &delta) || !varint_decode(p, end, &flags) || !varint_decode(p, end, &value_length)) {
+        return false;
+    }
+    s.key = static_cast<long long>(static_cast<uint64_t>(prev_key) + delta);
+    s.delete_flag = flags & 1;
+    s.merge_flag = (flags & ENTRY_MERGE_BIT) != 0;
+    s.timestamp = static_cast<time_t>((flags & ~ENTRY_MERGE_BIT) >> 1);
+    s.value_length = value_length;
+    return value_length <= static_cast<size_t>(end - p);
+}
+
+long long int entry_read(std::istream &is, SSTableDataEntry &s, long long prev_key) {
+    auto bytes = entry_read_head(is, s, prev_key);
+    s.value.clear();
+    bytes += bytes_read(is, &s.value, s.value_length);
+    return bytes;
+}
+
+void merge_operand_append(std::string &operands, const std::string &operand) {
+    auto os = std::ostringstream{};
+    varint_write(os, operand.length());
+    operands += os.str();
+    operands += operand;
+}
+
+std::string merge_operands_fold(const MergeOperator &merge_operator, const std::string *base,
+                                const std::string &operands) {
+    auto value = base != nullptr ? *base : std::string{};
+    auto has_value = base != nullptr;
+    const char *p = operands.data(), *end = operands.data() + operands.size();
+    uint64_t length = 0;
+    while (p < end && varint_decode(p, end, &length)) {
+        value = merge_operator(has_value ? &value : nullptr, std::string(p, length));
+        has_value = true;
+        p += length;
+    }
+    return value;
+}
+
+void merge_entries(const MergeOperator &merge_operator, SSTableDataEntry &newer, const SSTableDataEntry *older) {
+    if (!newer.merge_flag) {
+        return;
+    }
+    if (older != nullptr && older->merge_flag) {
+        newer.value = older->value + newer.value;
+    } else {
+        auto *base = older != nullptr && !older->delete_flag ? &older->value : nullptr;
+        newer.value = merge_operands_fold(merge_operator, base, newer.value);
+        newer.merge_flag = false;
+    }
+    newer.value_length = newer.value.length();
+}
+
+void coalesce_range_tombstones(RangeTombstones &tombstones) {
+    std::sort(tombstones.begin(), tombstones.end(), [](const RangeTombstone &a, const RangeTombstone &b) {
+        return a.lo < b.lo;
+    });
+    auto coalesced = RangeTombstones{};
+    for (const auto &t:tombstones) {
+        if (!coalesced.empty() && t.lo <= coalesced.back().hi) {
+            coalesced.back().hi = std::max(coalesced.back().hi, t.hi);
+        } else {
+            coalesced.push_back(t);
+        }
+    }
+    tombstones.swap(coalesced);
+}
+
+bool range_deleted(const RangeTombstones &tombstones, long long key) {
+    // Last tombstone starting at or before key is the only one which may cover it.
+    auto p = std::upper_bound(tombstones.begin(), tombstones.end(), key,
+                              [](long long k, const RangeTombstone &t) { return k < t.lo; });
+    return p != tombstones.begin() && std::prev(p)->hi >= key;
 }
 
 bool SSTableDataEntry::operator<(const SSTableDataEntry &rhs) {
@@ -72,6 +246,11 @@ std::istream &operator>>(std::istream &is, SSTableHeader &s) {
     bytes_read(is, &s.entries_count);
     bytes_read(is, &s.key_min);
     bytes_read(is, &s.key_max);
+    bytes_read(is, &s.filter_offset);
+    bytes_read(is, &s.restart_interval);
+    bytes_read(is, &s.range_tombstones);
+    bytes_read(is, &s.learned_index_offset);
+    bytes_read(is, &s.range_filter_offset);
     return is;
 }
 
@@ -80,6 +259,11 @@ std::ofstream &operator<<(std::ofstream &os, const SSTableHeader &s) {
     bytes_write(os, &s.entries_count);
     bytes_write(os, &s.key_min);
     bytes_write(os, &s.key_max);
+    bytes_write(os, &s.filter_offset);
+    bytes_write(os, &s.restart_interval);
+    bytes_write(os, &s.range_tombstones);
+    bytes_write(os, &s.learned_index_offset);
+    bytes_write(os, &s.range_filter_offset);
     return os;
 }
 
@@ -99,8 +283,10 @@ std::ofstream &operator<<(std::ofstream &os, const SSTableIndexItem &s) {
 SSTableHeader *SSTable::getHeader() {
     if (header == nullptr) {
         auto in = create_binary_ifstream(file);
-        header = new SSTableHeader{};
-        in >> *header;
+        auto h = std::make_unique<SSTableHeader>();
+        in >> *h;
+        check_read(in);
+        header = h.release();
     }
     return header;
 }
@@ -110,70 +296,397 @@ SSTableIndex *SSTable::getIndex() {
         auto *h = getHeader();
         auto in = create_binary_ifstream(file);
         in.seekg(h->index_offset);
-        index = new SSTableIndex{};
+        auto items = std::make_unique<SSTableIndex>();
         auto temp = SSTableIndexItem{};
-        while (in >> temp) {
-            index->push_back(temp);
+        while (in && static_cast<size_t>(in.tellg()) < h->filter_offset && in >> temp) {
+            items->push_back(temp);
         }
+        check_read(in);
+        index = items.release();
     }
     return index;
 }
 
-SSTableDataEntry SSTable::getEntry(long long offset) {
-    // Just offer basic reading by offset,
-    // search by key in index leave in DiskTable.
+SSTableIndex SSTable::readIndexRange(size_t first, size_t last) {
+    const auto item_size = sizeof(long long) + sizeof(size_t);
+    auto count = std::min(last + 1, restartsCount());
+    count = count > first ? count - first : 0;
+    auto buf = std::string(count * item_size, '\0');
+    readAt(buf.data(), buf.size(), getHeader()->index_offset + first * item_size);
+    auto range = SSTableIndex{};
+    range.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        auto item = SSTableIndexItem{};
+        std::memcpy(&item.key, buf.data() + i * item_size, sizeof(long long));
+        std::memcpy(&item.offset, buf.data() + i * item_size + sizeof(long long), sizeof(size_t));
+        range.push_back(item);
+    }
+    return range;
+}
+
+SSTableFileCache::File::~File() {
+    ::close(fd);
+}
+
+void SSTableFileCache::evict(size_t capacity) {
+    // Most recently used descriptor is never evicted, it's the one open has just added.
+    for (auto entry = lru.end(); lru.size() > capacity && entry != lru.begin() && std::prev(entry) != lru.begin();) {
+        entry--;
+        if (entry->second.use_count() == 1) {
+            map.erase(entry->first);
+            entry = lru.erase(entry);
+        }
+    }
+}
+
+SSTableFileCache::Handle SSTableFileCache::open(uint64_t owner, const path &file) {
+    std::lock_guard lock{mutex};
+    auto p = map.find(owner);
+    if (p != map.end()) {
+        lru.splice(lru.begin(), lru, p->second);
+        return p->second->second;
+    }
+    auto fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0 && (errno == EMFILE || errno == ENFILE)) {
+        evict(0);
+        fd = ::open(file.c_str(), O_RDONLY);
+    }
+    if (fd < 0) {
+        throw SSTableReadException();
+    }
+    auto handle = std::shared_ptr<File>(new File{fd});
+    lru.emplace_front(owner, handle);
+    map[owner] = lru.begin();
+    evict(SSTABLE_MAX_OPEN_FILES);
+    return handle;
+}
+
+void SSTableFileCache::erase(uint64_t owner) {
+    std::lock_guard lock{mutex};
+    auto p = map.find(owner);
+    if (p != map.end()) {
+        lru.erase(p->second);
+        map.erase(p);
+    }
+}
+
+SSTableFileCache &SSTableFileCache::instance() {
+    static SSTableFileCache cache;
+    return cache;
+}
+
+uint64_t SSTableFileCache::newOwner() {
+    static std::atomic<uint64_t> next_owner{1};
+    return next_owner++;
+}
+
+void SSTable::readAt(char *dst, size_t count, size_t offset) {
+    auto f = SSTableFileCache::instance().open(file_owner, file);
+    while (count > 0) {
+        auto n = ::pread(f->fd, dst, count, offset);
+        if (n <= 0) {
+            throw SSTableReadException();
+        }
+        dst += n;
+        count -= n;
+        offset += n;
+    }
+}
+
+void SSTable::closeFile() {
+    if (file_owner != 0) {
+        SSTableFileCache::instance().erase(file_owner);
+    }
+}
+
+size_t SSTable::restartsCount() {
+    auto *h = getHeader();
+    return (h->filter_offset - h->index_offset) / (sizeof(long long) + sizeof(size_t));
+}
+
+SSTableFilter *SSTable::readFilter() {
+    // Caller takes ownership of returned filter.
+    if (filter != nullptr) {
+        return filter->clone();
+    }
+    auto *h = getHeader();
+    auto in = create_binary_ifstream(file);
+    in.seekg(h->filter_offset);
+    auto f = std::unique_ptr<SSTableFilter>(SSTableFilter::read(in));
+    check_read(in);
+    return f.release();
+}
+
+PartitionedSSTableFilter::Head *SSTable::readPartitionedFilterHead() {
+    if (filter != nullptr) {
+        auto *partitioned = dynamic_cast<PartitionedSSTableFilter *>(filter);
+        return partitioned != nullptr ? new PartitionedSSTableFilter::Head{partitioned->getHead()} : nullptr;
+    }
+    auto *h = getHeader();
     auto in = create_binary_ifstream(file);
+    in.seekg(h->filter_offset);
+    uint64_t marker = 0;
+    int32_t tag = 0;
+    bytes_read(in, &marker);
+    bytes_read(in, &tag);
+    check_read(in);
+    if (marker != 0 || tag != PartitionedSSTableFilter::TYPE_TAG) {
+        return nullptr;
+    }
+    auto head = PartitionedSSTableFilter::readHead(in);
+    check_read(in);
+    return new PartitionedSSTableFilter::Head{std::move(head)};
+}
+
+SSTableFilter *SSTable::readFilterPartition(const PartitionedSSTableFilter::Head &head, size_t p) {
+    if (filter != nullptr) {
+        return static_cast<PartitionedSSTableFilter *>(filter)->partition(p)->clone();
+    }
+    auto buf = std::string(head.offsets[p + 1] - head.offsets[p], '\0');
+    readAt(buf.data(), buf.size(), getHeader()->filter_offset + head.offsets[p]);
+    auto in = std::istringstream{std::move(buf)};
+    return SSTableFilter::read(in);
+}
+
+LearnedIndex *SSTable::readLearnedIndex() {
+    // Caller takes ownership of returned learned index.
+    if (learned != nullptr) {
+        return new LearnedIndex{*learned};
+    }
+    auto *h = getHeader();
+    if (h->learned_index_offset == 0) {
+        return nullptr;
+    }
+    auto in = create_binary_ifstream(file);
+    in.seekg(h->learned_index_offset);
+    auto l = std::make_unique<LearnedIndex>();
+    in >> *l;
+    check_read(in);
+    return l.release();
+}
+
+RangeFilter *SSTable::readRangeFilter() {
+    // Caller takes ownership of returned range filter.
+    if (rangeFilter != nullptr) {
+        return new RangeFilter{*rangeFilter};
+    }
+    auto *h = getHeader();
+    if (h->range_filter_offset == 0) {
+        return nullptr;
+    }
+    auto in = create_binary_ifstream(file);
+    in.seekg(h->range_filter_offset);
+    auto r = std::make_unique<RangeFilter>();
+    in >> *r;
+    check_read(in);
+    return r.release();
+}
+
+RangeTombstones SSTable::readRangeTombstones() {
+    if (rangeTombstones != nullptr) {
+        return *rangeTombstones;
+    }
+    auto count = getHeader()->range_tombstones;
+    auto tombstones = RangeTombstones(count);
+    if (count == 0) {
+        return tombstones;
+    }
+    // Block of range tombstones is the last one of file.
+    auto bytes = count * sizeof(RangeTombstone);
+    readAt(reinterpret_cast<char *>(tombstones.data()), bytes, std::filesystem::file_size(file) - bytes);
+    return tombstones;
+}
+
+SSTableData SSTable::getRange(long long lo, long long hi, size_t restart_offset) {
+    auto *h = getHeader();
+    auto range = SSTableData{};
+    auto in = create_binary_ifstream(file);
+    in.seekg(restart_offset);
     auto temp = SSTableDataEntry{};
-    in.seekg(offset);
-    in >> temp;
-    return temp;
+    long long prev_key = 0;
+    for (size_t i = 0; static_cast<size_t>(in.tellg()) < h->index_offset; i++) {
+        entry_read(in, temp, i % h->restart_interval == 0 ? 0 : prev_key);
+        check_read(in);
+        prev_key = temp.key;
+        if (temp.key > hi) {
+            break;
+        }
+        if (temp.key >= lo) {
+            range.push_back(temp);
+        }
+    }
+    check_read(in);
+    return range;
+}
+
+SSTableDataEntry SSTable::getEntry(long long key, size_t restart_offset, size_t end_offset) {
+    // Return an entry whose timestamp is 0 if key is not in the restart interval.
+    auto buf = std::string(end_offset - restart_offset, '\0');
+    readAt(buf.data(), buf.size(), restart_offset);
+    const char *p = buf.data(), *end = buf.data() + buf.size();
+    auto temp = SSTableDataEntry{};
+    long long prev_key = 0;
+    while (p < end && entry_decode_head(p, end, temp, prev_key)) {
+        if (temp.key == key) {
+            temp.value.assign(p, temp.value_length);
+            return temp;
+        }
+        if (temp.key > key) {
+            break;
+        }
+        p += temp.value_length;
+        prev_key = temp.key;
+    }
+    return SSTableDataEntry{false, 0, 0, ""};
 }
 
 SSTableData *SSTable::getAllData() {
     if (data == nullptr || data->empty()) {
         auto *h = getHeader();
         auto in = create_binary_ifstream(file);
-        in.seekg(32); // Header always consume 32 bytes.
-        data = new SSTableData{};
+        in.seekg(SSTABLE_HEADER_SIZE);
+        auto entries = std::make_unique<SSTableData>();
+        entries->reserve(h->entries_count);
         auto temp = SSTableDataEntry{};
-        while (in.tellg() < h->index_offset) {
-            in >> temp;
-            data->push_back(std::move(temp));
+        long long prev_key = 0;
+        for (size_t i = 0; i < h->entries_count; i++) {
+            entry_read(in, temp, i % h->restart_interval == 0 ? 0 : prev_key);
+            prev_key = temp.key;
+            entries->push_back(std::move(temp));
         }
+        check_read(in);
+        delete data;
+        data = entries.release();
     }
     return data;
 }
 
-
-void SSTable::fillData(SSTableData &new_data) {
-    data = new SSTableData{new_data};
-    long long key_min = 0, key_max = 0;
-    size_t file_offset = 0, entries_count = data->size();
-    // Determining header.
-    key_min = data->begin()->key;
-    key_max = data->rbegin()->key;
-    file_offset = 32; // Header use 32 bytes.
-    size_t item_bytes = 0;
+void SSTable::buildMeta(const Options &options) {
+    // Determining header, restart index and filter from data.
+    auto entries_count = data->size();
+    auto key_min = data->begin()->key;
+    auto key_max = data->rbegin()->key;
+    size_t file_offset = SSTABLE_HEADER_SIZE;
+    long long prev_key = 0;
     index = new SSTableIndex{};
-    for (const auto &item:*data) {
-        index->push_back({item.key, file_offset});
-        item_bytes = size_of_entry(item);
-        file_offset += item_bytes;
+    auto keys = std::vector<long long>{};
+    keys.reserve(entries_count);
+    for (size_t i = 0; i < entries_count; i++) {
+        const auto &item = (*data)[i];
+        if (i % SSTABLE_RESTART_INTERVAL == 0) {
+            index->push_back({item.key, file_offset});
+            prev_key = 0;
+        }
+        file_offset += encoded_size_of_entry(item, prev_key);
+        prev_key = item.key;
+        keys.push_back(item.key);
     }
-    header = new SSTableHeader{file_offset, entries_count, key_min, key_max};
+    if (options.partitioned_metadata) {
+        auto restarts = std::max(options.metadata_partition_restarts, static_cast<size_t>(1));
+        filter = new PartitionedSSTableFilter{keys, restarts * SSTABLE_RESTART_INTERVAL, restarts, options};
+    } else {
+        filter = SSTableFilter::build(keys, options);
+    }
+    auto filter_offset = file_offset + index->size() * (sizeof(long long) + sizeof(size_t));
+    auto meta_end = filter_offset + filter->size_bytes();
+    size_t learned_index_offset = 0;
+    if (options.learned_index) {
+        auto restart_keys = std::vector<long long>{};
+        restart_keys.reserve(index->size());
+        for (const auto &item:*index) {
+            restart_keys.push_back(item.key);
+        }
+        learned = new LearnedIndex{restart_keys, options.learned_index_epsilon};
+        learned_index_offset = meta_end;
+        meta_end += learned->size_bytes();
+    }
+    size_t range_filter_offset = 0;
+    if (options.range_filter) {
+        rangeFilter = new RangeFilter{keys, options.filter_bits_per_key};
+        range_filter_offset = meta_end;
+    }
+    uint32_t range_tombstones = 0;
+    if (rangeTombstones != nullptr && !rangeTombstones->empty()) {
+        // Sstables a tombstone would hide keys of must be found overlapping this one by key range.
+        key_min = std::min(key_min, rangeTombstones->front().lo);
+        for (const auto &t:*rangeTombstones) {
+            key_max = std::max(key_max, t.hi);
+        }
+        range_tombstones = rangeTombstones->size();
+    }
+    header = new SSTableHeader{file_offset, entries_count, key_min, key_max, filter_offset, SSTABLE_RESTART_INTERVAL,
+                               range_tombstones, learned_index_offset, range_filter_offset};
+}
+
+void SSTable::fillData(SSTableData &new_data, const Options &options) {
+    data = new SSTableData{new_data};
+    buildMeta(options);
 }
 
-void SSTable::writeToDisk(const path &dst_file) {
-    auto os = create_binary_ofstream(dst_file);
+size_t SSTable::metaBytes() const {
+    auto bytes = header->filter_offset - header->index_offset;
+    bytes += filter != nullptr ? filter->size_bytes() : 0;
+    bytes += learned != nullptr ? learned->size_bytes() : 0;
+    bytes += rangeFilter != nullptr ? rangeFilter->size_bytes() : 0;
+    bytes += rangeTombstones != nullptr ? rangeTombstones->size() * sizeof(RangeTombstone) : 0;
+    return bytes;
+}
+
+void SSTable::writeToDisk(const path &dst_file, bool sync, const WriteThrottle &throttle) {
+    auto tmp_file = path{dst_file}.concat(".tmp");
+    auto os = create_binary_ofstream(tmp_file);
+    auto charge = [&throttle, &os](size_t bytes) {
+        if (throttle) {
+            os.flush(); // Bytes taken before are on their way to disk before waiting for the next ones.
+            throttle(bytes);
+        }
+    };
+    charge(SSTABLE_HEADER_SIZE);
     os << *header;
-    for (const auto &item:*data) {
-        os << item;
+    long long prev_key = 0;
+    for (size_t i = 0; i < data->size();) {
+        auto end = i;
+        size_t block_bytes = 0;
+        for (auto key = prev_key; end < data->size() && block_bytes < SSTABLE_WRITE_BLOCK_SIZE; end++) {
+            block_bytes += encoded_size_of_entry((*data)[end], end % header->restart_interval == 0 ? 0 : key);
+            key = (*data)[end].key;
+        }
+        charge(block_bytes);
+        for (; i < end; i++) {
+            entry_write(os, (*data)[i], i % header->restart_interval == 0 ? 0 : prev_key);
+            prev_key = (*data)[i].key;
+        }
     }
+    charge(metaBytes());
     for (const auto &item:*index) {
         os << item;
     }
+    if (filter != nullptr) {
+        filter->write(os);
+    }
+    if (learned != nullptr) {
+        os << *learned;
+    }
+    if (rangeFilter != nullptr) {
+        os << *rangeFilter;
+    }
+    if (rangeTombstones != nullptr) {
+        for (const auto &t:*rangeTombstones) {
+            bytes_write(os, &t);
+        }
+    }
     os.flush();
     os.close();
+    if (os.fail()) {
+        throw SyncFailedException(); // A short file must never be renamed into place.
+    }
+    if (sync) {
+        sync_path(tmp_file);
+    }
+    rename(tmp_file, dst_file);
+    if (sync) {
+        sync_path(dst_file.parent_path());
+    }
     file = dst_file; // Make connection between SSTable object and disk file.
 }
 
@@ -187,43 +700,58 @@ SSTable::SSTable(const path &filepath) {
 }
 
 SSTable::~SSTable() {
+    closeFile();
     delete header;
     delete data;
     delete index;
+    delete filter;
+    delete learned;
+    delete rangeFilter;
+    delete rangeTombstones;
 }
 
-void SSTable::fillData(SSTableData &&new_data) {
+void SSTable::fillData(SSTableData &&new_data, const Options &options, RangeTombstones &&range_tombstones) {
     data = new SSTableData{std::move(new_data)};
-    long long key_min = 0, key_max = 0;
-    size_t file_offset = 0, entries_count = data->size();
-    // Determining header.
-    key_min = data->begin()->key;
-    key_max = data->rbegin()->key;
-    file_offset = 32; // Header use 32 bytes.
-    size_t item_bytes = 0;
-    index = new SSTableIndex{};
-    for (const auto &item:*data) {
-        index->push_back({item.key, file_offset});
-        item_bytes = size_of_entry(item);
-        file_offset += item_bytes;
+    if (!range_tombstones.empty()) {
+        rangeTombstones = new RangeTombstones{std::move(range_tombstones)};
+        coalesce_range_tombstones(*rangeTombstones);
     }
-    header = new SSTableHeader{file_offset, entries_count, key_min, key_max};
+    buildMeta(options);
 }
 
 void SSTable::clearDataCache() {
     // Just used to clear unnecessary data cached in SSTable object after merge, not to clear data stored in disk.
-    delete data;
-    data = nullptr;
+    // Compaction clears sstables readers may be loading metadata of concurrently, only what is cached is touched.
+    auto clear = [](auto *&cached) {
+        if (cached != nullptr) {
+            delete cached;
+            cached = nullptr;
+        }
+    };
+    clear(data);
+    clear(filter);
+    clear(learned);
+    clear(rangeFilter);
+    clear(rangeTombstones);
 }
 
 void SSTable::removeFromDisk() {
+    closeFile();
     remove(file);
     delete data;
     delete header;
     delete index;
+    delete filter;
+    delete learned;
+    delete rangeFilter;
+    delete rangeTombstones;
     data = nullptr;
     header = nullptr;
     index = nullptr;
+    filter = nullptr;
+    learned = nullptr;
+    rangeFilter = nullptr;
+    rangeTombstones = nullptr;
 }
 
 SSTable::SSTable(SSTable &&rhs) noexcept {
@@ -231,9 +759,19 @@ SSTable::SSTable(SSTable &&rhs) noexcept {
     header = rhs.header;
     data = rhs.data;
     index = rhs.index;
+    filter = rhs.filter;
+    learned = rhs.learned;
+    rangeFilter = rhs.rangeFilter;
+    rangeTombstones = rhs.rangeTombstones;
+    file_owner = rhs.file_owner;
+    rhs.file_owner = 0;
+    rhs.learned = nullptr;
+    rhs.rangeFilter = nullptr;
+    rhs.rangeTombstones = nullptr;
     rhs.header = nullptr;
     rhs.data = nullptr;
     rhs.index = nullptr;
+    rhs.filter = nullptr;
 }
 
 path SSTable::getFile() {
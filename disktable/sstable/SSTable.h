@@ -11,6 +11,17 @@
 #include <filesystem>
 #include <exception>
 #include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+#include "../../bloom_filter/SSTableFilter.h"
+#include "../../bloom_filter/RangeFilter.h"
+#include "../LearnedIndex.h"
+#include "../../Options.h"
 
 using namespace std::filesystem;
 using std::ios_base;
@@ -19,6 +30,14 @@ std::ifstream create_binary_ifstream(const path &file);
 
 std::ofstream create_binary_ofstream(const path &file);
 
+// Data written may not be on disk: a write, flush or fsync failed.
+class SyncFailedException : public std::exception {
+};
+
+// fsync a file, or a directory so that files created, renamed or removed in it are durable.
+// Throw SyncFailedException if it can't be, so that nothing is recorded as durable when it isn't.
+void sync_path(const path &p);
+
 template<typename T>
 long long int bytes_read(std::istream &is, T *dst, long long int count = 0) {
     long long bytes = count != 0 ? count : sizeof(T);
@@ -33,24 +52,55 @@ long long int bytes_write(std::ostream &os, const T *src, long long int count =
     return bytes;
 }
 
+// Unsigned LEB128, used for key deltas, packed flags and value lengths of data entries.
+long long int varint_write(std::ostream &os, uint64_t v);
+
+long long int varint_read(std::istream &is, uint64_t *dst);
+
+size_t varint_length(uint64_t v);
+
+// Decode from a buffer read from disk, advancing p. Return false if buffer ends before varint does.
+bool varint_decode(const char *&p, const char *end, uint64_t *dst);
+
+const size_t SSTABLE_HEADER_SIZE = 64;
+
+const size_t SSTABLE_RESTART_INTERVAL = 16;
+
+const size_t SSTABLE_MAX_OPEN_FILES = 512;
+
+const size_t SSTABLE_WRITE_BLOCK_SIZE = 64 * 1024;
+
 struct SSTableHeader {
     size_t index_offset;
     size_t entries_count;
     long long key_min;
     long long key_max;
+    size_t filter_offset;
+    // restart_interval and range_tombstones share the 8 bytes restart_interval once took,
+    // range_tombstones of an sstable written before range deletes is read as 0.
+    uint32_t restart_interval;
+    uint32_t range_tombstones; // Count of range tombstones, stored at the end of file.
+    size_t learned_index_offset; // 0 if sstable has no learned index.
+    size_t range_filter_offset; // 0 if sstable has no range filter.
 
     friend std::istream &operator>>(std::istream &is, SSTableHeader &s);
 
     friend std::ofstream &operator<<(std::ofstream &os, const SSTableHeader &s);
 };
 
-// Delim of two entries is ' '
+/*
+ * On disk an entry is laid out as varint(key delta), varint(timestamp << 1 | delete_flag), varint(value_length), value.
+ * merge_flag is the highest bit of the second varint, which timestamps never reach, so only merge entries pay for it.
+ * Key delta is taken against previous entry, except at restart points (every restart_interval entries) where the full
+ * key is stored, so decoding can start from any restart point recorded in the index.
+ */
 struct SSTableDataEntry {
     bool delete_flag = false;
     time_t timestamp;
     long long key;
     size_t value_length;
     std::string value;
+    bool merge_flag = false; // Value is operands written by merge, see merge_operand_append.
 
     SSTableDataEntry() = default;
 
@@ -58,10 +108,6 @@ struct SSTableDataEntry {
 
     SSTableDataEntry(bool d_f, time_t ts, long long k, const char *v);
 
-    friend std::istream &operator>>(std::istream &is, SSTableDataEntry &s);
-
-    friend std::ofstream &operator<<(std::ofstream &os, const SSTableDataEntry &s);
-
     bool operator<(const SSTableDataEntry &rhs);
 
 };
@@ -69,8 +115,52 @@ struct SSTableDataEntry {
 
 size_t size_of_entry(const SSTableDataEntry &s);
 
+// prev_key should be 0 at restart points.
+size_t encoded_size_of_entry(const SSTableDataEntry &s, long long prev_key);
+
+long long int entry_write(std::ostream &os, const SSTableDataEntry &s, long long prev_key);
+
+// Read key, flags and value_length of an entry, leaving stream at the beginning of its value.
+long long int entry_read_head(std::istream &is, SSTableDataEntry &s, long long prev_key);
+
+long long int entry_read(std::istream &is, SSTableDataEntry &s, long long prev_key);
+
+// Buffer version of entry_read_head, leave p at the beginning of value.
+bool entry_decode_head(const char *&p, const char *end, SSTableDataEntry &s, long long prev_key);
+
 using SSTableData=std::vector<SSTableDataEntry>;
 
+// Operands of a merge entry are its value, each as varint(length) followed by operand, oldest first,
+// so that operands of two merge entries of a key are joined by concatenating their values.
+void merge_operand_append(std::string &operands, const std::string &operand);
+
+// Apply operands in order to base, nullptr if key has no value.
+std::string merge_operands_fold(const MergeOperator &merge_operator, const std::string *base,
+                                const std::string &operands);
+
+// Combine a merge entry with the next older entry of its key, nullptr if there is none: newer becomes a put of
+// operands folded into older's value, or a merge entry with older's operands ahead of its own if older is one.
+// Entry other than a merge entry is left as it is, it shadows older.
+void merge_entries(const MergeOperator &merge_operator, SSTableDataEntry &newer, const SSTableDataEntry *older);
+
+/*
+ * Delete of every key in [lo, hi]. Instead of a timestamp, it takes effect by position: a range tombstone of a memtable
+ * or an sstable hides entries of older memtables and sstables, never those of the one holding it, which are written
+ * after it (see MemTable::removeRange). Compaction keeps this by applying tombstones of newer inputs to older ones.
+ */
+struct RangeTombstone {
+    long long lo;
+    long long hi;
+};
+
+using RangeTombstones=std::vector<RangeTombstone>;
+
+// Sort tombstones by lo and merge overlapping ones, range_deleted expects tombstones in this form.
+void coalesce_range_tombstones(RangeTombstones &tombstones);
+
+bool range_deleted(const RangeTombstones &tombstones, long long key);
+
+// One item per restart point.
 struct SSTableIndexItem {
     long long key;
     size_t offset;
@@ -85,12 +175,69 @@ using SSTableIndex=std::vector<SSTableIndexItem>;
 class SSTableFileNotExistsException : public std::exception {
 };
 
+// Part of an sstable could not be read, a missing value would otherwise be taken as an absent key.
+class SSTableReadException : public std::exception {
+};
+
+/*
+ * LRU cache of file descriptors sstables read through with pread, shared by every sstable of the process and bounded
+ * by SSTABLE_MAX_OPEN_FILES. A descriptor evicted while a reader still uses it is closed once that reader is done.
+ * If the process runs out of descriptors anyway, idle ones are closed and open is retried.
+ */
+class SSTableFileCache {
+private:
+    struct File {
+        int fd;
+
+        ~File();
+    };
+
+    std::mutex mutex;
+    std::list<std::pair<uint64_t, std::shared_ptr<File>>> lru; // Most recently used first.
+    std::unordered_map<uint64_t, decltype(lru)::iterator> map;
+
+    // Close least recently used descriptors no reader is using until at most capacity are left open.
+    // The most recently used one is always kept.
+    void evict(size_t capacity);
+
+public:
+    using Handle=std::shared_ptr<const File>;
+
+    // Descriptor of file, opened if owner has none cached. Throw SSTableReadException if it can't be opened.
+    Handle open(uint64_t owner, const path &file);
+
+    void erase(uint64_t owner);
+
+    static SSTableFileCache &instance();
+
+    static uint64_t newOwner();
+};
+
 class SSTable {
+public:
+    // Called with bytes of every block of a file before the block is written, may block to pace writes.
+    using WriteThrottle=std::function<void(size_t bytes)>;
+
 private:
     path file;
     SSTableHeader *header{};
     SSTableData *data{};
     SSTableIndex *index{};
+    SSTableFilter *filter{};
+    LearnedIndex *learned{};
+    RangeFilter *rangeFilter{};
+    RangeTombstones *rangeTombstones{};
+    uint64_t file_owner = SSTableFileCache::newOwner(); // Key of fd of file in SSTableFileCache, 0 after a move.
+
+    void buildMeta(const Options &options);
+
+    // Bytes of index, filters and range tombstones, written after data.
+    size_t metaBytes() const;
+
+    // Positioned read through fd, safe to be called from several threads. Throw SSTableReadException on failure.
+    void readAt(char *dst, size_t count, size_t offset);
+
+    void closeFile();
 public:
 
     explicit SSTable();
@@ -101,21 +248,53 @@ public:
 
     SSTableHeader *getHeader();
 
-    SSTableDataEntry getEntry(long long key);
+    // Read restart interval [restart_offset, end_offset) with one read, and search key in it.
+    // Reads of this and every other method throw SSTableReadException if sstable can't be read.
+    SSTableDataEntry getEntry(long long key, size_t restart_offset, size_t end_offset);
 
     SSTableData *getAllData();
 
+    // Entries with key in [lo, hi], reading sequentially from the restart point at restart_offset.
+    SSTableData getRange(long long lo, long long hi, size_t restart_offset);
+
     SSTableIndex *getIndex();
 
+    // Read restart points [first, last] from index on disk, without caching whole index.
+    // Fewer items are returned if last is beyond the end of index.
+    SSTableIndex readIndexRange(size_t first, size_t last);
+
+    size_t restartsCount();
+
+    SSTableFilter *readFilter();
+
+    // nullptr if filter of sstable is not partitioned. Caller takes ownership.
+    PartitionedSSTableFilter::Head *readPartitionedFilterHead();
+
+    // Partition p of a partitioned filter, with a single read. Caller takes ownership.
+    SSTableFilter *readFilterPartition(const PartitionedSSTableFilter::Head &head, size_t p);
+
+    // nullptr if sstable has no learned index.
+    LearnedIndex *readLearnedIndex();
+
+    // nullptr if sstable has no range filter.
+    RangeFilter *readRangeFilter();
+
+    // Empty if sstable has no range tombstones.
+    RangeTombstones readRangeTombstones();
+
     ~SSTable();
 
-    void fillData(SSTableData &new_data);
+    void fillData(SSTableData &new_data, const Options &options = Options{});
 
-    void fillData(SSTableData &&new_data);
+    // Key range of header covers range_tombstones as well as keys of new_data.
+    void fillData(SSTableData &&new_data, const Options &options = Options{}, RangeTombstones &&range_tombstones = {});
 
     void clearDataCache();
 
-    void writeToDisk(const path &dst_file);
+    // Written to a temporary file renamed to dst_file once complete, so dst_file is never seen partially written.
+    // With sync, data is on disk when it returns. With throttle, file is written in blocks of about
+    // SSTABLE_WRITE_BLOCK_SIZE, each flushed to the file once throttle returns.
+    void writeToDisk(const path &dst_file, bool sync = false, const WriteThrottle &throttle = nullptr);
 
     void removeFromDisk();
 
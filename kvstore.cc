@@ -14,14 +14,22 @@
 
 std::atomic<bool> gracefully_exit_flag = false;
 
-KVStore::KVStore(const std::string &dir) : KVStoreAPI(dir) {
+KVStore::KVStore(const std::string &dir) : KVStore(dir, Options{}) {
+}
+
+KVStore::KVStore(const std::string &dir, const Options &options) : KVStoreAPI(dir),
+                                                                  read_threads(options.async_read_threads) {
     auto data_dir = path(dir);
-    lsmTree = new LSMTree{data_dir};
+    auto tree_options = options;
+    tree_options.merge_operator = storedMergeOperator(options.merge_operator);
+    lsmTree = new LSMTree{data_dir, tree_options};
     std::signal(SIGINT, [](int sig) { gracefully_exit_flag.store(true); });
     std::signal(SIGTERM, [](int sig) { gracefully_exit_flag.store(true); });
 }
 
 KVStore::~KVStore() {
+    stopAsyncWriter();
+    stopReadPool();
     delete lsmTree;
 }
 
@@ -31,18 +39,7 @@ KVStore::~KVStore() {
  */
 void KVStore::put(uint64_t key, const std::string &s) {
     check_gracefully_exit();
-#ifdef WITH_GZIP
-    auto data = std::string{};
-    if (s.length() >= 100) {
-        data = gzip::compress(s.data(), s.length());
-        lsmTree->put(key, data);
-    } else {
-        lsmTree->put(key, s);
-    }
-
-#else
-    lsmTree->put(key,s);
-#endif
+    lsmTree->put(key, encodeValue(s));
 }
 
 /**
@@ -51,16 +48,63 @@ void KVStore::put(uint64_t key, const std::string &s) {
  */
 std::string KVStore::get(uint64_t key) {
     check_gracefully_exit();
+    return decodeValue(lsmTree->get(key));
+}
+
+void KVStore::scan(uint64_t key1, uint64_t key2, std::list<std::pair<uint64_t, std::string>> &list) {
+    check_gracefully_exit();
+    auto result = std::list<std::pair<long long, std::string>>{};
+    for (const auto &[lo, hi]:signedRanges(key1, key2)) {
+        lsmTree->scan(lo, hi, result);
+    }
+    for (auto &[key, value]:result) {
+        list.emplace_back(key, decodeValue(std::move(value)));
+    }
+}
+
+void KVStore::delete_range(uint64_t key1, uint64_t key2) {
+    check_gracefully_exit();
+    for (const auto &[lo, hi]:signedRanges(key1, key2)) {
+        lsmTree->deleteRange(lo, hi);
+    }
+}
+
+void KVStore::merge(uint64_t key, const std::string &operand) {
+    check_gracefully_exit();
+    lsmTree->merge(key, operand);
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> KVStore::signedRanges(uint64_t key1, uint64_t key2) {
+    const auto sign_bit = static_cast<uint64_t>(1) << 63;
+    if (key1 > key2) {
+        return {};
+    }
+    if (key1 < sign_bit && key2 >= sign_bit) {
+        return {{key1, sign_bit - 1}, {sign_bit, key2}};
+    }
+    return {{key1, key2}};
+}
+
+MemoryUsage KVStore::memoryUsage() {
+    return lsmTree->memoryUsage();
+}
+
+std::string KVStore::encodeValue(const std::string &s) {
+#ifdef WITH_GZIP
+    if (s.length() >= 100) {
+        return gzip::compress(s.data(), s.length());
+    }
+#endif
+    return s;
+}
+
+std::string KVStore::decodeValue(std::string &&stored) {
 #ifdef WITH_GZIP
-    auto compressed = lsmTree->get(key);
-    if (gzip::is_compressed(compressed.data(), compressed.size())) {
-        return gzip::decompress(compressed.data(), compressed.size());
-    } else {
-        return compressed;
+    if (gzip::is_compressed(stored.data(), stored.size())) {
+        return gzip::decompress(stored.data(), stored.size());
     }
-#else
-    return lsmTree->get(key);
 #endif
+    return std::move(stored);
 }
 
 /**
@@ -78,11 +122,119 @@ bool KVStore::del(uint64_t key) {
  */
 void KVStore::reset() {
     check_gracefully_exit();
+    stopAsyncWriter(); // Ops queued before reset are applied first.
+    stopReadPool();
     lsmTree->reset();
 }
 
+MergeOperator KVStore::storedMergeOperator(const MergeOperator &merge_operator) {
+    if (!merge_operator) {
+        return nullptr;
+    }
+    return [merge_operator](const std::string *existing_value, const std::string &operand) {
+        if (existing_value == nullptr) {
+            return encodeValue(merge_operator(nullptr, operand));
+        }
+        auto decoded = decodeValue(std::string{*existing_value});
+        return encodeValue(merge_operator(&decoded, operand));
+    };
+}
+
+std::future<bool> KVStore::async_put(uint64_t key, const std::string &s) {
+    check_gracefully_exit();
+    // Compress on calling thread, applier only touches memtable.
+    return getAsyncWriter()->submit(WriteOp{WriteOp::Type::Put, static_cast<long long>(key), encodeValue(s)});
+}
+
+std::future<bool> KVStore::async_del(uint64_t key) {
+    check_gracefully_exit();
+    return getAsyncWriter()->submit(WriteOp{WriteOp::Type::Del, static_cast<long long>(key), ""});
+}
+
+std::future<std::string> KVStore::async_get(uint64_t key) {
+    check_gracefully_exit();
+    return getReadPool()->submit([this, key] { return decodeValue(lsmTree->get(key)); });
+}
+
+std::future<std::vector<std::string>> KVStore::async_multi_get(const std::vector<uint64_t> &keys) {
+    check_gracefully_exit();
+    struct MultiGet {
+        std::vector<std::string> values;
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed{false};
+        std::promise<std::vector<std::string>> done;
+    };
+    auto state = std::make_shared<MultiGet>();
+    state->values.resize(keys.size());
+    state->remaining = keys.size();
+    auto result = state->done.get_future();
+    if (keys.empty()) {
+        state->done.set_value({});
+        return result;
+    }
+    // Every key is a job of its own, the last one to finish resolves the future,
+    // so no pool thread is blocked waiting for the others.
+    auto *pool = getReadPool();
+    for (size_t i = 0; i < keys.size(); i++) {
+        pool->submit([this, state, i, key = keys[i]] {
+            try {
+                state->values[i] = decodeValue(lsmTree->get(key));
+            } catch (...) {
+                // First failure resolves the future, it's never resolved twice.
+                if (!state->failed.exchange(true)) {
+                    state->done.set_exception(std::current_exception());
+                }
+            }
+            if (state->remaining.fetch_sub(1) == 1 && !state->failed) {
+                state->done.set_value(std::move(state->values));
+            }
+        });
+    }
+    return result;
+}
+
+AsyncWriter *KVStore::getAsyncWriter() {
+    auto *writer = asyncWriter.load();
+    if (writer == nullptr) {
+        std::lock_guard lock{async_writer_mutex};
+        writer = asyncWriter.load();
+        if (writer == nullptr) {
+            writer = new AsyncWriter{lsmTree};
+            asyncWriter.store(writer);
+        }
+    }
+    return writer;
+}
+
+void KVStore::stopAsyncWriter() {
+    // Callers must not issue async ops at the same time, like any other op racing with reset.
+    std::lock_guard lock{async_writer_mutex};
+    delete asyncWriter.exchange(nullptr);
+}
+
+ThreadPool *KVStore::getReadPool() {
+    auto *pool = readPool.load();
+    if (pool == nullptr) {
+        std::lock_guard lock{read_pool_mutex};
+        pool = readPool.load();
+        if (pool == nullptr) {
+            pool = new ThreadPool{read_threads};
+            readPool.store(pool);
+        }
+    }
+    return pool;
+}
+
+void KVStore::stopReadPool() {
+    // Gets already submitted are served before the pool is gone.
+    std::lock_guard lock{read_pool_mutex};
+    delete readPool.exchange(nullptr);
+}
+
 void KVStore::check_gracefully_exit() {
     if (gracefully_exit_flag.load()) {
+        stopAsyncWriter();
+        stopReadPool();
         delete lsmTree;
         exit(0);
     }
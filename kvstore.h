@@ -2,7 +2,13 @@
 
 #include "kvstore_api.h"
 #include "lsmtree/LSMTree.h"
+#include "lsmtree/AsyncWriter.h"
+#include "thread_pool/ThreadPool.h"
+#include <vector>
+#include <list>
 #include <atomic>
+#include <future>
+#include <mutex>
 
 extern std::atomic<bool> gracefully_exit_flag;
 
@@ -10,10 +16,25 @@ class KVStore : public KVStoreAPI {
     // You can add your implementation here
 private:
     LSMTree *lsmTree;
+    std::atomic<AsyncWriter *> asyncWriter{nullptr}; // Created on first async op.
+    std::mutex async_writer_mutex;
+    std::atomic<ThreadPool *> readPool{nullptr}; // Created on first async read.
+    std::mutex read_pool_mutex;
+    size_t read_threads;
+
+    AsyncWriter *getAsyncWriter();
+
+    void stopAsyncWriter();
+
+    ThreadPool *getReadPool();
+
+    void stopReadPool();
 
 public:
     KVStore(const std::string &dir);
 
+    KVStore(const std::string &dir, const Options &options);
+
     ~KVStore();
 
     void put(uint64_t key, const std::string &s) override;
@@ -24,6 +45,45 @@ public:
 
     void reset() override;
 
+    // Append key-value pairs with key in [key1, key2] to list in ascending order of keys.
+    void scan(uint64_t key1, uint64_t key2, std::list<std::pair<uint64_t, std::string>> &list);
+
+    // Delete every key in [key1, key2] at the cost of one del, whatever the count of keys in it.
+    void delete_range(uint64_t key1, uint64_t key2);
+
+    // Fold operand into value of key by options.merge_operator, without reading value first.
+    // Throws MergeOperatorNotSetException if options has no merge operator.
+    void merge(uint64_t key, const std::string &operand);
+
+    // Queued to a single applier thread, future is resolved once the op is applied.
+    // Ops issued by one thread are applied in the order they were issued.
+    std::future<bool> async_put(uint64_t key, const std::string &s);
+
+    // Resolved with what del would return.
+    std::future<bool> async_del(uint64_t key);
+
+    // Served by a pool of reader threads, each disk lookup is a single positioned read of one restart interval,
+    // so many outstanding gets keep the device busy instead of one at a time.
+    std::future<std::string> async_get(uint64_t key);
+
+    // Keys are looked up concurrently, values are in the same order as keys.
+    std::future<std::vector<std::string>> async_multi_get(const std::vector<uint64_t> &keys);
+
+    // Bytes taken by memtables, caches and sstable metadata.
+    MemoryUsage memoryUsage();
+
     void check_gracefully_exit();
 
+    // Values of at least 100 bytes are stored gzip compressed when built with zlib.
+    static std::string encodeValue(const std::string &s);
+
+    static std::string decodeValue(std::string &&stored);
+
+    // Keys are stored in LSMTree as long long, where keys from 2^63 on come before the others.
+    // Split [key1, key2] at 2^63 into ranges ordered the same either way, in ascending order of keys.
+    static std::vector<std::pair<uint64_t, uint64_t>> signedRanges(uint64_t key1, uint64_t key2);
+
+    // merge_operator working on stored values, which are encoded by encodeValue. Operands are stored as they are.
+    static MergeOperator storedMergeOperator(const MergeOperator &merge_operator);
+
 };
@@ -0,0 +1,57 @@
+#include "AsyncWriter.h"
+#include <chrono>
+
+AsyncWriter::AsyncWriter(LSMTree *tree) : tree(tree) {
+    applier = std::thread{[this] { run(); }};
+}
+
+AsyncWriter::~AsyncWriter() {
+    {
+        std::lock_guard lock{idle_mutex};
+        stopping = true;
+    }
+    idle_cv.notify_one();
+    applier.join();
+}
+
+std::future<bool> AsyncWriter::submit(WriteOp &&op) {
+    auto pending = PendingOp{std::move(op), std::promise<bool>{}};
+    auto result = pending.done.get_future();
+    queue.enqueue(std::move(pending));
+    if (idle.load()) {
+        // Taking the lock makes sure applier is either still checking queue or already waiting.
+        std::lock_guard lock{idle_mutex};
+        idle_cv.notify_one();
+    }
+    return result;
+}
+
+void AsyncWriter::run() {
+    auto pendings = std::vector<PendingOp>(MAX_BATCH);
+    auto batch = std::vector<WriteOp>{};
+    batch.reserve(MAX_BATCH);
+    while (true) {
+        auto count = queue.try_dequeue_bulk(pendings.begin(), MAX_BATCH);
+        if (count == 0) {
+            auto lock = std::unique_lock{idle_mutex};
+            if (stopping && queue.size_approx() == 0) {
+                break;
+            }
+            idle = true;
+            if (queue.size_approx() == 0) {
+                // Timeout only guards against size_approx missing an op being enqueued.
+                idle_cv.wait_for(lock, std::chrono::milliseconds(10));
+            }
+            idle = false;
+            continue;
+        }
+        batch.clear();
+        for (size_t i = 0; i < count; i++) {
+            batch.push_back(std::move(pendings[i].op));
+        }
+        auto results = tree->write(batch);
+        for (size_t i = 0; i < count; i++) {
+            pendings[i].done.set_value(results[i]);
+        }
+    }
+}
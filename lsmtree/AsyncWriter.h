@@ -0,0 +1,46 @@
+#ifndef LSMTREE_ASYNCWRITER_H
+#define LSMTREE_ASYNCWRITER_H
+
+#include "LSMTree.h"
+#include <concurrent_queue/concurrent_queue.h>
+#include <future>
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+/*
+ * Write front-end of a LSMTree. Producer threads only enqueue their ops into a lock-free queue,
+ * a single applier thread drains it and applies ops in batches through LSMTree::write,
+ * so producers never contend on write lock of the LSMTree.
+ * Ops enqueued by one thread are applied in the order they were enqueued, there is no order among threads.
+ */
+class AsyncWriter {
+private:
+    struct PendingOp {
+        WriteOp op;
+        std::promise<bool> done;
+    };
+
+    LSMTree *tree;
+    moodycamel::ConcurrentQueue<PendingOp> queue;
+    std::thread applier;
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+    std::atomic<bool> idle{false};
+    std::atomic<bool> stopping{false};
+    const size_t MAX_BATCH = 256;
+
+    void run();
+
+public:
+    explicit AsyncWriter(LSMTree *tree);
+
+    // Apply all ops already enqueued, then stop applier.
+    ~AsyncWriter();
+
+    // Resolved with what LSMTree::put/del returns once op has been applied to memtable.
+    std::future<bool> submit(WriteOp &&op);
+};
+
+
+#endif //LSMTREE_ASYNCWRITER_H
@@ -4,58 +4,387 @@
 
 #include "LSMTree.h"
 
-LSMTree::LSMTree(path &data_dir) {
-    memory = new MemTable{};
-    disk = new DiskTable{data_dir};
+LSMTree::LSMTree(path &data_dir, const Options &options) : options(options), memtable_limit(options.memtable_size) {
+    disk = new DiskTable{data_dir, options};
     data_home = data_dir;
+    if (options.row_cache_bytes != 0) {
+        rowCache = new RowCache{options.row_cache_bytes, options.row_cache_shards};
+    }
+    if (options.memory_budget != 0) {
+        budget = new MemoryBudget{options};
+        memtable_limit = budget->memtableLimit(options.memtable_size, options.background_flush ?
+                                                                      options.max_immutable_memtables + 1 : 1);
+        rebalanceCaches();
+    }
+    install(SuperVersion{std::make_shared<MemTable>(), {}, disk->current(), disk->keyFilter()});
+    startFlushWorker();
+    startCompactionWorker();
+}
+
+LSMTree::SuperVersionPtr LSMTree::acquire() {
+    return std::atomic_load(&current);
+}
+
+void LSMTree::install(SuperVersion &&sv) {
+    std::atomic_store(&current, SuperVersionPtr{std::make_shared<SuperVersion>(std::move(sv))});
 }
 
 std::string LSMTree::get(long long key) {
-    auto memory_result = memory->get(key);
-    if (memory_result != nullptr) {
-        return *memory_result;
+    // Epoch must be taken before SuperVersion, see RowCache.
+    uint64_t cache_epoch = 0;
+    auto cached = std::string{};
+    auto cache_hit = rowCache != nullptr && rowCache->lookup(key, cached, cache_epoch);
+    auto sv = acquire();
+    // Operands of merge entries found in memtables, oldest first, they apply to the value found below them.
+    auto operands = std::string{};
+    auto value_of = [this, &operands](const std::string *base) {
+        if (operands.empty()) {
+            return base != nullptr ? *base : std::string{};
+        }
+        return merge_operands_fold(options.merge_operator, base, operands);
+    };
+    auto value = std::string{};
+    // Whether memtable decides value of key, which is then set.
+    auto search = [key, &operands, &value, &value_of](MemTable &memtable) {
+        auto *entry = memtable.getEntry(key);
+        if (entry != nullptr && !entry->merge_flag) {
+            value = value_of(entry->delete_flag ? nullptr : &entry->value);
+            return true;
+        }
+        if (entry != nullptr) {
+            operands.insert(0, entry->value);
+        }
+        if (memtable.rangeDeleted(key)) {
+            value = value_of(nullptr);
+            return true;
+        }
+        return false;
+    };
+    {
+        std::shared_lock lock{memory_mutex};
+        if (search(*sv->memory)) {
+            return value;
+        }
+    }
+    for (const auto &immutable:sv->immutables) {
+        // Immutable memtables are never modified, no lock needed.
+        if (search(*immutable)) {
+            return value;
+        }
+    }
+    if (cache_hit) {
+        return value_of(cached.empty() ? nullptr : &cached);
+    }
+    if (sv->keys != nullptr && !sv->keys->mightContain(key)) {
+        return value_of(nullptr);
+    }
+    auto[success, disk_result]=DiskTable::get(sv->disk, key, options.merge_operator);
+    if (!success) {
+        disk_result.clear();
+    }
+    if (rowCache != nullptr) {
+        rowCache->insert(key, disk_result, cache_epoch);
+    }
+    return value_of(success ? &disk_result : nullptr);
+}
+
+void LSMTree::scan(long long lo, long long hi, std::list<std::pair<long long, std::string>> &result) {
+    // Sources are visited from newest to oldest, the first entry of a key found wins,
+    // unless a range tombstone of a source visited before covers it.
+    auto sv = acquire();
+    auto entries = std::map<long long, SSTableDataEntry>{};
+    auto deleted = RangeTombstones{};
+    {
+        std::shared_lock lock{memory_mutex};
+        for (auto &entry:sv->memory->collectRange(lo, hi)) {
+            entries.emplace(entry.key, std::move(entry));
+        }
+        deleted = sv->memory->collectRangeTombstones();
+    }
+    for (const auto &immutable:sv->immutables) {
+        for (auto &entry:immutable->collectRange(lo, hi)) {
+            if (!range_deleted(deleted, entry.key)) {
+                DiskTable::addScanned(entries, std::move(entry), options.merge_operator);
+            }
+        }
+        auto tombstones = immutable->collectRangeTombstones();
+        deleted.insert(deleted.end(), tombstones.begin(), tombstones.end());
+        coalesce_range_tombstones(deleted);
+    }
+    DiskTable::scan(sv->disk, lo, hi, entries, deleted, options.merge_operator);
+    for (auto &[key, entry]:entries) {
+        merge_entries(options.merge_operator, entry, nullptr); // Nothing older is left for it.
+        if (!entry.delete_flag) {
+            result.emplace_back(key, std::move(entry.value));
+        }
+    }
+}
+
+void LSMTree::flush() {
+    // Switch active memtable to immutable first, so that readers can still find its data
+    // while it's being persisted.
+    auto version_lock = std::unique_lock{version_mutex};
+    stall_cv.wait(version_lock, [this] {
+        auto sv = acquire();
+        auto immutables_full = options.background_flush && sv->immutables.size() >= options.max_immutable_memtables;
+        return !immutables_full && !level0Full(*sv);
+    });
+    auto switched = SuperVersion{*acquire()};
+    switched.immutables.push_front(switched.memory);
+    switched.memory = std::make_shared<MemTable>();
+    install(std::move(switched));
+    if (options.background_flush) {
+        flush_cv.notify_one();
     } else {
-        auto[success, disk_result]=disk->get(key);
-        if (success) {
-            return disk_result;
-        } else {
-            return "";
+        persistOldestImmutable(version_lock);
+    }
+}
+
+bool LSMTree::level0Full(const SuperVersion &sv) const {
+    // Only compaction worker takes sstables out of level 0 while writers wait, without it flush compacts them.
+    return options.rate_limiter != nullptr && options.level0_stop_factor != 0 &&
+           sv.disk->front().size() > options.level0_stop_factor * options.level0_limit;
+}
+
+void LSMTree::persistOldestImmutable(std::unique_lock<std::mutex> &version_lock) {
+    // Only one thread (flush worker, or the writer if there is no worker) persists memtables.
+    auto to_persist = acquire()->immutables.back();
+    version_lock.unlock();
+    disk->persistent(*to_persist);
+    version_lock.lock();
+    auto persisted = SuperVersion{*acquire()};
+    persisted.immutables.remove(to_persist);
+    persisted.disk = disk->current();
+    install(std::move(persisted));
+    stall_cv.notify_all();
+    rebalanceCaches(); // Metadata of new sstables may have been loaded by compaction.
+    compaction_pending = true;
+    compaction_cv.notify_one();
+}
+
+void LSMTree::startFlushWorker() {
+    if (!options.background_flush) {
+        return;
+    }
+    stopping = false;
+    flush_worker = std::thread{[this] {
+        auto version_lock = std::unique_lock{version_mutex};
+        while (true) {
+            flush_cv.wait(version_lock, [this] { return stopping || !acquire()->immutables.empty(); });
+            if (acquire()->immutables.empty()) {
+                // Stop only after all immutable memtables are persisted.
+                break;
+            }
+            persistOldestImmutable(version_lock);
         }
+    }};
+}
+
+void LSMTree::stopFlushWorker() {
+    if (!flush_worker.joinable()) {
+        return;
+    }
+    {
+        auto version_lock = std::unique_lock{version_mutex};
+        stopping = true;
     }
+    flush_cv.notify_one();
+    flush_worker.join();
 }
 
-void LSMTree::put(long long key, const std::string &s) {
-    memory->put(key, s);
-    if (memory->size_bytes() > MEMTABLE_LIMIT) {
-        disk->persistent(std::move(*memory));
-        memory = new MemTable{};
+void LSMTree::startCompactionWorker() {
+    if (options.rate_limiter == nullptr) {
+        return;
     }
+    compaction_stopping = false;
+    compaction_pending = true; // Sstables left by last run may need compaction.
+    compaction_worker = std::thread{[this] {
+        auto version_lock = std::unique_lock{version_mutex};
+        while (true) {
+            compaction_cv.wait(version_lock, [this] { return compaction_stopping || compaction_pending; });
+            if (compaction_stopping) {
+                break;
+            }
+            compaction_pending = false;
+            version_lock.unlock();
+            auto compacted = disk->compactOnce();
+            version_lock.lock();
+            if (compacted) {
+                auto sv = SuperVersion{*acquire()};
+                sv.disk = disk->current();
+                install(std::move(sv));
+                stall_cv.notify_all(); // Level 0 may have gone down.
+                rebalanceCaches();
+                compaction_pending = true; // Policy may pick another one on the new version.
+            }
+        }
+    }};
+}
+
+void LSMTree::stopCompactionWorker() {
+    if (!compaction_worker.joinable()) {
+        return;
+    }
+    {
+        auto version_lock = std::unique_lock{version_mutex};
+        compaction_stopping = true;
+    }
+    compaction_cv.notify_one();
+    compaction_worker.join();
+}
+
+void LSMTree::rebalanceCaches() {
+    if (budget == nullptr) {
+        return;
+    }
+    auto capacities = budget->cacheCapacities(disk->metadataBytes());
+    disk->getBlockCache()->setCapacity(capacities.block_cache);
+    if (rowCache != nullptr) {
+        rowCache->setCapacity(capacities.row_cache);
+    }
+}
+
+MemoryUsage LSMTree::memoryUsage() {
+    auto usage = MemoryUsage{};
+    auto sv = acquire();
+    {
+        std::shared_lock lock{memory_mutex};
+        usage.memtables = sv->memory->size_bytes();
+    }
+    for (const auto &immutable:sv->immutables) {
+        usage.memtables += immutable->size_bytes();
+    }
+    usage.row_cache = rowCache != nullptr ? rowCache->usage() : 0;
+    std::lock_guard version_lock{version_mutex}; // reset replaces disk under it.
+    usage.block_cache = disk->getBlockCache()->usage();
+    usage.metadata = disk->metadataBytes();
+    return usage;
+}
+
+void LSMTree::put(long long key, const std::string &s) {
+    std::lock_guard write_lock{write_mutex};
+    _put(key, s);
 }
 
 bool LSMTree::del(long long key) {
+    std::lock_guard write_lock{write_mutex};
+    return _del(key);
+}
+
+void LSMTree::merge(long long key, const std::string &operand) {
+    if (!options.merge_operator) {
+        throw MergeOperatorNotSetException{};
+    }
+    std::lock_guard write_lock{write_mutex};
+    auto sv = acquire();
+    {
+        std::unique_lock lock{memory_mutex};
+        sv->memory->merge(key, operand, options.merge_operator);
+    }
+    if (rowCache != nullptr) {
+        rowCache->erase(key);
+    }
+    if (sv->memory->size_bytes() > memtable_limit) {
+        flush();
+    }
+}
+
+void LSMTree::deleteRange(long long lo, long long hi) {
+    if (lo > hi) {
+        return;
+    }
+    std::lock_guard write_lock{write_mutex};
+    auto sv = acquire();
+    {
+        std::unique_lock lock{memory_mutex};
+        sv->memory->removeRange(lo, hi);
+    }
+    if (rowCache != nullptr) {
+        rowCache->eraseRange(lo, hi);
+    }
+    if (sv->memory->size_bytes() > memtable_limit) {
+        flush();
+    }
+}
+
+std::vector<bool> LSMTree::write(const std::vector<WriteOp> &batch) {
+    std::lock_guard write_lock{write_mutex};
+    auto results = std::vector<bool>{};
+    results.reserve(batch.size());
+    for (const auto &op:batch) {
+        if (op.type == WriteOp::Type::Put) {
+            _put(op.key, op.value);
+            results.push_back(true);
+        } else {
+            results.push_back(_del(op.key));
+        }
+    }
+    return results;
+}
+
+void LSMTree::_put(long long key, const std::string &s) {
+    auto sv = acquire();
+    {
+        std::unique_lock lock{memory_mutex};
+        sv->memory->put(key, s);
+    }
+    if (rowCache != nullptr) {
+        rowCache->erase(key);
+    }
+    if (sv->memory->size_bytes() > memtable_limit) {
+        flush();
+    }
+}
+
+bool LSMTree::_del(long long key) {
     if (get(key).empty()) {
         return false;
     }
-    memory->remove(key);
-    if (memory->size_bytes() > MEMTABLE_LIMIT) {
-        disk->persistent(std::move(*memory), true);
-        memory = new MemTable{};
+    auto sv = acquire();
+    {
+        std::unique_lock lock{memory_mutex};
+        sv->memory->remove(key);
+    }
+    if (rowCache != nullptr) {
+        rowCache->erase(key);
+    }
+    if (sv->memory->size_bytes() > memtable_limit) {
+        flush();
     }
     return true;
 }
 
 void LSMTree::reset() {
-    delete memory;
-    delete disk;
-    remove_all(data_home);
-    memory = new MemTable{};
-    disk = new DiskTable{data_home};
+    std::lock_guard write_lock{write_mutex};
+    stopFlushWorker();
+    stopCompactionWorker();
+    // Readers still holding old SuperVersion keep their memtables alive, no one else touches them any more.
+    // Obsolete sstables they hold are removed by path once released, new sstables must not take their numbers.
+    {
+        std::lock_guard version_lock{version_mutex};
+        auto clock = disk->clock();
+        delete disk;
+        remove_all(data_home);
+        disk = new DiskTable{data_home, options, clock};
+        if (rowCache != nullptr) {
+            rowCache->clear();
+        }
+        install(SuperVersion{std::make_shared<MemTable>(), {}, disk->current(), disk->keyFilter()});
+        rebalanceCaches();
+    }
+    startFlushWorker();
+    startCompactionWorker();
 }
 
 LSMTree::~LSMTree() {
-    if (memory->size() != 0) {
-        disk->persistent(std::move(*memory));
+    std::lock_guard write_lock{write_mutex};
+    stopFlushWorker();
+    stopCompactionWorker();
+    auto sv = acquire();
+    if (sv->memory->size() != 0) {
+        disk->persistent(*sv->memory);
     }
-    delete memory;
     delete disk;
+    delete rowCache;
+    delete budget;
 }
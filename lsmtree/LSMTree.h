@@ -7,25 +7,122 @@
 
 #include "../memtable/MemTable.h"
 #include "../disktable/DiskTable.h"
+#include "RowCache.h"
+#include "MemoryBudget.h"
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <list>
+
+/*
+ * Everything a reader needs to answer a get: active memtable, memtables being persisted and sstables on disk.
+ * A reader takes one reference to current SuperVersion and works on it without any other lock,
+ * except a shared lock on active memtable, which is the only part modified in place.
+ * Writers build a new SuperVersion and install it atomically.
+ */
+struct SuperVersion {
+    std::shared_ptr<MemTable> memory;
+    std::list<std::shared_ptr<MemTable>> immutables; // Newest first.
+    DiskTable::Version disk;
+    DiskTable::KeyFilterPtr keys; // nullptr if key filter is disabled.
+};
+
+class MergeOperatorNotSetException : public std::exception {
+};
+
+struct WriteOp {
+    enum class Type {
+        Put, Del
+    };
+    Type type;
+    long long key;
+    std::string value; // Empty for Del.
+};
 
 class LSMTree {
 private:
-    MemTable *memory;
-    DiskTable *disk;
+    using SuperVersionPtr=std::shared_ptr<const SuperVersion>;
+
+    SuperVersionPtr current; // Always accessed by std::atomic_load/std::atomic_store.
+    DiskTable *disk; // Replaced by reset under version_mutex, readers outside writer and workers take it to use disk.
+    RowCache *rowCache = nullptr; // Only if options.row_cache_bytes is not 0.
+    MemoryBudget *budget = nullptr; // Only if options.memory_budget is not 0.
     path data_home;
-    const int MEMTABLE_LIMIT = 2 * 1000 * 1000;
+    Options options;
+    std::mutex write_mutex; // Serialize put, del and reset.
+    std::shared_mutex memory_mutex; // Guard active memtable against readers while it's being modified.
+    std::mutex version_mutex; // Serialize building and installing new SuperVersion between writers and flush worker.
+    std::condition_variable flush_cv; // Notify flush worker of new immutable memtable or stopping.
+    // Notify stalled writers that an immutable memtable is persisted, or that compaction has installed a version.
+    std::condition_variable stall_cv;
+    std::thread flush_worker;
+    bool stopping = false;
+    // Only with options.rate_limiter, throttled compaction runs here instead of holding flushes back.
+    std::condition_variable compaction_cv; // Notify compaction worker of new sstables or stopping.
+    std::thread compaction_worker;
+    bool compaction_pending = false;
+    bool compaction_stopping = false;
+    size_t memtable_limit; // options.memtable_size, lowered to fit memory budget.
+
+    SuperVersionPtr acquire();
+
+    void install(SuperVersion &&sv);
+
+    // Switch active memtable to an immutable one and have it persisted. Wait first while too many memtables are
+    // waiting to be persisted, or level 0 is full, see Options::level0_stop_factor.
+    void flush();
+
+    // Whether sv has too many sstables in level 0 for another memtable to be switched.
+    bool level0Full(const SuperVersion &sv) const;
+
+    void persistOldestImmutable(std::unique_lock<std::mutex> &version_lock);
+
+    void startFlushWorker();
+
+    void stopFlushWorker();
+
+    void startCompactionWorker();
+
+    // Stop once the compaction running is done, compaction left is picked up by the next worker.
+    void stopCompactionWorker();
+
+    // Fit capacities of caches into what memory budget leaves them. Caller holds version_mutex, unless no other
+    // thread can see this LSMTree yet.
+    void rebalanceCaches();
+
+    void _put(long long key, const std::string &s);
+
+    bool _del(long long key);
+
 public:
-    explicit LSMTree(path &data_dir);
+    explicit LSMTree(path &data_dir, const Options &options = Options{});
 
     ~LSMTree();
 
     std::string get(long long key);
 
+    // Append key-value pairs with key in [lo, hi] to result in ascending order of keys.
+    void scan(long long lo, long long hi, std::list<std::pair<long long, std::string>> &result);
+
     void put(long long key, const std::string &s);
 
     bool del(long long key);
 
+    // Apply options.merge_operator to value of key and operand, without reading value first.
+    // Throws MergeOperatorNotSetException if there is no merge operator.
+    void merge(long long key, const std::string &operand);
+
+    // Delete every key in [lo, hi] with a single range tombstone, without reading them first.
+    void deleteRange(long long lo, long long hi);
+
+    // Apply ops in order with one acquisition of write lock, results[i] is what put/del would return for batch[i].
+    std::vector<bool> write(const std::vector<WriteOp> &batch);
+
     void reset();
+
+    MemoryUsage memoryUsage();
 };
 
 
@@ -0,0 +1,38 @@
+#include "MemoryBudget.h"
+#include <algorithm>
+
+size_t MemoryUsage::total() const {
+    return memtables + block_cache + row_cache + metadata;
+}
+
+MemoryBudget::MemoryBudget(const Options &options) : budget(options.memory_budget),
+                                                     write_buffer_ratio(options.write_buffer_ratio),
+                                                     block_cache_bytes(options.block_cache_bytes),
+                                                     row_cache_bytes(options.row_cache_bytes) {
+    write_buffer_ratio = std::clamp(write_buffer_ratio, 0.0, 1.0);
+}
+
+size_t MemoryBudget::getBudget() const {
+    return budget;
+}
+
+size_t MemoryBudget::writeBufferLimit() const {
+    return static_cast<size_t>(budget * write_buffer_ratio);
+}
+
+size_t MemoryBudget::memtableLimit(size_t memtable_limit, size_t max_memtables) const {
+    // Every memtable, the active one and those waiting to be persisted, may be full at the same time.
+    auto limit = writeBufferLimit() / std::max(max_memtables, static_cast<size_t>(1));
+    return std::max(std::min(limit, memtable_limit), static_cast<size_t>(1));
+}
+
+MemoryBudget::CacheCapacities MemoryBudget::cacheCapacities(size_t metadata) const {
+    auto reserved = writeBufferLimit() + metadata;
+    auto left = budget > reserved ? budget - reserved : 0;
+    auto wanted = block_cache_bytes + row_cache_bytes;
+    if (wanted <= left) {
+        return {block_cache_bytes, row_cache_bytes};
+    }
+    auto block_cache = static_cast<size_t>(static_cast<double>(left) * block_cache_bytes / wanted);
+    return {block_cache, left - block_cache};
+}
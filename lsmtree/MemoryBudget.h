@@ -0,0 +1,50 @@
+#ifndef LSMTREE_MEMORYBUDGET_H
+#define LSMTREE_MEMORYBUDGET_H
+
+#include "../Options.h"
+#include <cstddef>
+
+// Bytes taken by every component of a LSMTree.
+struct MemoryUsage {
+    size_t memtables = 0; // Active and immutable ones.
+    size_t block_cache = 0;
+    size_t row_cache = 0;
+    size_t metadata = 0; // Filters and indexes of sstables kept in memory, outside of block cache.
+
+    [[nodiscard]] size_t total() const;
+};
+
+/*
+ * Splits Options::memory_budget among components of a LSMTree.
+ * Memtables get write_buffer_ratio of the budget, a memtable is flushed earlier than its usual size if needed
+ * to keep active and immutable ones within that share.
+ * Caches get what is left after memtables and metadata, in proportion to their configured sizes
+ * but never more than configured, so growing metadata shrinks caches and evicts blocks.
+ */
+class MemoryBudget {
+private:
+    size_t budget;
+    double write_buffer_ratio;
+    size_t block_cache_bytes;
+    size_t row_cache_bytes;
+
+public:
+    explicit MemoryBudget(const Options &options);
+
+    [[nodiscard]] size_t getBudget() const;
+
+    [[nodiscard]] size_t writeBufferLimit() const;
+
+    // Size at which active memtable is flushed, no larger than memtable_limit.
+    [[nodiscard]] size_t memtableLimit(size_t memtable_limit, size_t max_memtables) const;
+
+    struct CacheCapacities {
+        size_t block_cache;
+        size_t row_cache;
+    };
+
+    [[nodiscard]] CacheCapacities cacheCapacities(size_t metadata) const;
+};
+
+
+#endif //LSMTREE_MEMORYBUDGET_H
@@ -0,0 +1,114 @@
+#include "RowCache.h"
+
+RowCache::RowCache(size_t capacity, size_t shards_count) : shards(shards_count == 0 ? 1 : shards_count) {
+    shard_capacity = capacity / shards.size();
+}
+
+RowCache::Shard &RowCache::shardOf(long long key) {
+    // Sequential keys should spread over shards, multiply by golden ratio to mix low bits up.
+    auto h = static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ULL;
+    return shards[(h >> 32) % shards.size()];
+}
+
+size_t RowCache::chargeOf(const std::string &value) {
+    // Rough overhead of a list node plus a hash map node.
+    return value.size() + sizeof(long long) + 64;
+}
+
+bool RowCache::lookup(long long key, std::string &value, uint64_t &epoch) {
+    auto &shard = shardOf(key);
+    std::lock_guard lock{shard.mutex};
+    epoch = shard.epoch;
+    auto p = shard.map.find(key);
+    if (p == shard.map.end()) {
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, p->second);
+    value = p->second->second;
+    return true;
+}
+
+void RowCache::evict(Shard &shard, size_t capacity) {
+    while (shard.usage > capacity && !shard.lru.empty()) {
+        auto &victim = shard.lru.back();
+        shard.usage -= chargeOf(victim.second);
+        shard.map.erase(victim.first);
+        shard.lru.pop_back();
+    }
+}
+
+void RowCache::insert(long long key, const std::string &value, uint64_t epoch) {
+    auto charge = chargeOf(value);
+    auto capacity = shard_capacity.load();
+    if (charge > capacity) {
+        return;
+    }
+    auto &shard = shardOf(key);
+    std::lock_guard lock{shard.mutex};
+    if (shard.epoch != epoch || shard.map.count(key) != 0) {
+        return;
+    }
+    shard.lru.emplace_front(key, value);
+    shard.map[key] = shard.lru.begin();
+    shard.usage += charge;
+    evict(shard, capacity);
+}
+
+void RowCache::erase(long long key) {
+    auto &shard = shardOf(key);
+    std::lock_guard lock{shard.mutex};
+    shard.epoch++;
+    auto p = shard.map.find(key);
+    if (p != shard.map.end()) {
+        shard.usage -= chargeOf(p->second->second);
+        shard.lru.erase(p->second);
+        shard.map.erase(p);
+    }
+}
+
+void RowCache::eraseRange(long long lo, long long hi) {
+    for (auto &shard:shards) {
+        std::lock_guard lock{shard.mutex};
+        shard.epoch++;
+        for (auto p = shard.lru.begin(); p != shard.lru.end();) {
+            if (p->first < lo || p->first > hi) {
+                p++;
+                continue;
+            }
+            shard.usage -= chargeOf(p->second);
+            shard.map.erase(p->first);
+            p = shard.lru.erase(p);
+        }
+    }
+}
+
+void RowCache::clear() {
+    for (auto &shard:shards) {
+        std::lock_guard lock{shard.mutex};
+        shard.epoch++;
+        shard.lru.clear();
+        shard.map.clear();
+        shard.usage = 0;
+    }
+}
+
+size_t RowCache::usage() {
+    size_t total = 0;
+    for (auto &shard:shards) {
+        std::lock_guard lock{shard.mutex};
+        total += shard.usage;
+    }
+    return total;
+}
+
+size_t RowCache::capacity() const {
+    return shard_capacity.load() * shards.size();
+}
+
+void RowCache::setCapacity(size_t capacity) {
+    shard_capacity = capacity / shards.size();
+    for (auto &shard:shards) {
+        std::lock_guard lock{shard.mutex};
+        evict(shard, shard_capacity.load());
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef LSMTREE_ROWCACHE_H
+#define LSMTREE_ROWCACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <atomic>
+
+/*
+ * Key -> value results of lookups which went to disk, so that hot keys in deep levels skip the disk path.
+ * Split into shards each with its own lock and LRU list, total size of entries is bounded by capacity bytes.
+ * An empty value is cached as well, it means the key is not on disk or is deleted.
+ *
+ * Every erase bumps epoch of its shard. A reader takes epoch before looking up memtables and disk,
+ * and insert is dropped if epoch has changed since, so a value read before a concurrent put/del
+ * never lands in cache after that put/del invalidated the key.
+ */
+class RowCache {
+private:
+    struct Shard {
+        using Entry=std::pair<long long, std::string>;
+
+        std::mutex mutex;
+        std::list<Entry> lru; // Most recently used first.
+        std::unordered_map<long long, std::list<Entry>::iterator> map;
+        size_t usage = 0;
+        uint64_t epoch = 0;
+    };
+
+    std::vector<Shard> shards;
+    std::atomic<size_t> shard_capacity;
+
+    static void evict(Shard &shard, size_t capacity);
+
+    Shard &shardOf(long long key);
+
+    static size_t chargeOf(const std::string &value);
+
+public:
+    RowCache(size_t capacity, size_t shards_count);
+
+    // Return false on miss. epoch of the key is filled in either case, to be passed to insert.
+    bool lookup(long long key, std::string &value, uint64_t &epoch);
+
+    void insert(long long key, const std::string &value, uint64_t epoch);
+
+    void erase(long long key);
+
+    // Erase every key in [lo, hi], bumping epoch of every shard.
+    void eraseRange(long long lo, long long hi);
+
+    void clear();
+
+    size_t usage();
+
+    size_t capacity() const;
+
+    // Evict least recently used entries at once if usage is over new capacity.
+    void setCapacity(size_t capacity);
+};
+
+
+#endif //LSMTREE_ROWCACHE_H
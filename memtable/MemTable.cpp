@@ -15,6 +15,7 @@ MemTable::MemTable(MemTable &&m) noexcept {
     qlist = std::move(m.qlist);
     _size_bytes = m._size_bytes;
     _size = m._size;
+    range_tombstones = std::move(m.range_tombstones);
     m._size_bytes = 0;
     m._size = 0;
 }
@@ -62,15 +63,17 @@ auto MemTable::skipSearch(MemTable::LevelIter level, long long key) {
     return result;
 }
 
-bool MemTable::_put(NodePosi pred_node, long long key, std::string value, bool delete_flag) {
+bool MemTable::_put(NodePosi pred_node, long long key, std::string value, bool delete_flag, bool merge_flag) {
     auto curr_level = qlist.rbegin(); // If skipSearch didn't find k, it must return a appropriate position
     // at the bottom of qlist for insert a new tower of k
-    static auto seed = time(nullptr);
-    static auto gen = std::mt19937_64{static_cast<unsigned long long> (seed)};
-    static auto rand = std::uniform_int_distribution<>{0, 1};
+    // Memtables of different LSMTrees may be written from different threads.
+    static thread_local auto seed = time(nullptr);
+    static thread_local auto gen = std::mt19937_64{static_cast<unsigned long long> (seed)};
+    static thread_local auto rand = std::uniform_int_distribution<>{0, 1};
     auto timestamp = time(nullptr);
-    auto new_node = curr_level->insertAfterAbove(MemTableEntry{delete_flag, timestamp, key, std::move(value)},
-                                                 pred_node);
+    auto entry = MemTableEntry{delete_flag, timestamp, key, std::move(value)};
+    entry.merge_flag = merge_flag;
+    auto new_node = curr_level->insertAfterAbove(std::move(entry), pred_node);
     _size_bytes += size_of_node(new_node);
     while (rand(gen)) {
         while (!pred_node->above && curr_level->valid(pred_node))
@@ -111,6 +114,7 @@ bool MemTable::put(long long k, std::string v) {
         node->data.value_length = v.length();
         node->data.value = std::move(v);
         node->data.timestamp = timestamp;
+        node->data.merge_flag = false;
         _size_bytes += size_of_node(node);
         return true;
     }
@@ -150,6 +154,7 @@ bool MemTable::remove(long long k) {
         to_delete->data.value = "";
         to_delete->data.timestamp = timestamp;
         to_delete->data.value_length = 0;
+        to_delete->data.merge_flag = false;
         _size_bytes += size_of_node(to_delete);
         do {
             to_delete->data.delete_flag = true;
@@ -164,6 +169,35 @@ bool MemTable::remove(long long k) {
     return true;
 }
 
+void MemTable::merge(long long k, const std::string &operand, const MergeOperator &merge_operator) {
+    auto[valid, node] = skipSearch(qlist.begin(), k);
+    if (valid && node->data.merge_flag) {
+        _size_bytes -= size_of_node(node);
+        merge_operand_append(node->data.value, operand);
+        node->data.value_length = node->data.value.length();
+        node->data.timestamp = time(nullptr);
+        _size_bytes += size_of_node(node);
+        return;
+    }
+    if (valid) {
+        put(k, merge_operator(node->data.delete_flag ? nullptr : &node->data.value, operand));
+        return;
+    }
+    if (rangeDeleted(k)) {
+        put(k, merge_operator(nullptr, operand));
+        return;
+    }
+    auto operands = std::string{};
+    merge_operand_append(operands, operand);
+    _put(node, k, std::move(operands), false, true);
+}
+
+const SSTableDataEntry *MemTable::getEntry(long long k) {
+    if (qlist.empty()) return nullptr;
+    auto[valid, res] = skipSearch(qlist.begin(), k);
+    return res->data.key == k && valid ? &(res->data) : nullptr;
+}
+
 size_t MemTable::size_of_node(MemTable::NodePosi node) {
     if (node == nullptr) {
         return 0;
@@ -172,16 +206,56 @@ size_t MemTable::size_of_node(MemTable::NodePosi node) {
 }
 
 SSTableData MemTable::collectData() {
+    // Copy rather than move entries out, readers may still be searching this memtable while it is being persisted.
     auto new_data = SSTableData{};
+    new_data.reserve(_size);
     auto *bottomStart = (--qlist.end())->first()->succ;
     auto *bottomEnd = (--qlist.end())->last();
     while (bottomStart != bottomEnd) {
-        new_data.push_back(std::move(bottomStart->data));
+        new_data.push_back(bottomStart->data);
         bottomStart = bottomStart->succ;
     }
     return new_data;
 }
 
+SSTableData MemTable::collectRange(long long lo, long long hi) {
+    auto range = SSTableData{};
+    if (qlist.empty()) {
+        return range;
+    }
+    // If lo is not found, skipSearch stops at the last node before it in the bottom level.
+    auto[valid, node] = skipSearch(qlist.begin(), lo);
+    auto bottom = --qlist.end();
+    if (!valid) {
+        node = node->succ;
+    }
+    while (bottom->valid(node) && node->data.key <= hi) {
+        range.push_back(node->data);
+        node = node->succ;
+    }
+    return range;
+}
+
+void MemTable::removeRange(long long lo, long long hi) {
+    for (const auto &entry:collectRange(lo, hi)) {
+        if (!entry.delete_flag) {
+            remove(entry.key);
+        }
+    }
+    remove(lo);
+    range_tombstones.push_back({lo, hi});
+    coalesce_range_tombstones(range_tombstones);
+    _size_bytes += sizeof(RangeTombstone);
+}
+
+bool MemTable::rangeDeleted(long long k) const {
+    return range_deleted(range_tombstones, k);
+}
+
+RangeTombstones MemTable::collectRangeTombstones() const {
+    return range_tombstones;
+}
+
 size_t MemTable::size_bytes() {
     return _size_bytes;
 }
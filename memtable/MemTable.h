@@ -26,13 +26,15 @@ protected:
 
     auto skipSearch(LevelIter level, long long key);
 
-    bool _put(NodePosi pred_node, long long key, std::string value, bool delete_flag);
+    bool _put(NodePosi pred_node, long long key, std::string value, bool delete_flag, bool merge_flag = false);
 
     static size_t size_of_node(NodePosi node);
 
     long long _size = 0;
 
     size_t _size_bytes = 0;
+
+    RangeTombstones range_tombstones; // Coalesced.
 public:
     explicit MemTable();
 
@@ -46,6 +48,13 @@ public:
 
     bool remove(long long k) override;
 
+    // Merge operand into value of k. If value of k is in this memtable, or is known to be absent,
+    // operand is applied at once, otherwise it's kept in a merge entry for reads and compaction to apply.
+    void merge(long long k, const std::string &operand, const MergeOperator &merge_operator);
+
+    // Entry of k, nullptr if k is not in this memtable.
+    const SSTableDataEntry *getEntry(long long k);
+
     [[nodiscard]] int levels() const {
         return qlist.size();
     }
@@ -53,6 +62,21 @@ public:
     size_t size_bytes();
 
     SSTableData collectData();
+
+    // Copy of entries with key in [lo, hi], deleted ones included.
+    SSTableData collectRange(long long lo, long long hi);
+
+    /*
+     * Delete every key in [lo, hi] with a range tombstone, which hides keys of older memtables and sstables.
+     * Keys already in this memtable are marked deleted one by one, so that keys put after it are the only entries
+     * of this memtable in [lo, hi] which are not deleted, and they win over the tombstone, see RangeTombstone.
+     * A tombstone of lo is added as well, so that a memtable holding range tombstones is never empty.
+     */
+    void removeRange(long long lo, long long hi);
+
+    bool rangeDeleted(long long k) const;
+
+    RangeTombstones collectRangeTombstones() const;
 };
 
 
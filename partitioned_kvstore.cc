@@ -0,0 +1,113 @@
+#include "partitioned_kvstore.h"
+#include "kvstore.h"
+#include "bloom_filter/Murmur.h"
+
+PartitionedKVStore::PartitionedKVStore(const std::string &dir, size_t partitions_count, const Options &options)
+        : KVStoreAPI(dir) {
+    open(dir, partitions_count, options);
+}
+
+PartitionedKVStore::PartitionedKVStore(const std::string &dir, const std::vector<uint64_t> &split_keys,
+                                       const Options &options) : KVStoreAPI(dir), split_keys(split_keys) {
+    std::sort(this->split_keys.begin(), this->split_keys.end());
+    open(dir, split_keys.size() + 1, options);
+}
+
+void PartitionedKVStore::open(const std::string &dir, size_t partitions_count, const Options &options) {
+    auto data_dir = path(dir);
+    if (!exists(data_dir)) {
+        create_directory(data_dir);
+    }
+    partitions.resize(partitions_count);
+    checkLayout(data_dir);
+    auto partition_options = options;
+    partition_options.background_flush = true; // Every partition owns a flush worker.
+    partition_options.merge_operator = KVStore::storedMergeOperator(options.merge_operator);
+    for (size_t i = 0; i < partitions_count; i++) {
+        auto partition_dir = data_dir / ("p" + std::to_string(i));
+        partitions[i] = new LSMTree{partition_dir, partition_options};
+    }
+}
+
+void PartitionedKVStore::checkLayout(const path &data_dir) {
+    // Layout file: partitions count(8 bytes), split keys count(8 bytes), then split keys.
+    auto layout_file = data_dir / "partitions.lock";
+    size_t count = partitions.size(), splits = split_keys.size();
+    if (exists(layout_file)) {
+        auto is = create_binary_ifstream(layout_file);
+        size_t recorded_count = 0, recorded_splits = 0;
+        bytes_read(is, &recorded_count);
+        bytes_read(is, &recorded_splits);
+        auto recorded_split_keys = std::vector<uint64_t>(recorded_splits);
+        for (auto &k:recorded_split_keys) {
+            bytes_read(is, &k);
+        }
+        if (recorded_count != count || recorded_split_keys != split_keys) {
+            throw PartitionLayoutMismatchException{};
+        }
+        return;
+    }
+    auto os = create_binary_ofstream(layout_file);
+    bytes_write(os, &count);
+    bytes_write(os, &splits);
+    for (const auto &k:split_keys) {
+        bytes_write(os, &k);
+    }
+}
+
+PartitionedKVStore::~PartitionedKVStore() {
+    for (auto *partition:partitions) {
+        delete partition;
+    }
+}
+
+LSMTree *PartitionedKVStore::route(uint64_t key) {
+    if (split_keys.empty()) {
+        return partitions[MurmurHash64A(&key, sizeof(key), 0) % partitions.size()];
+    }
+    auto p = std::upper_bound(split_keys.begin(), split_keys.end(), key);
+    return partitions[std::distance(split_keys.begin(), p)];
+}
+
+void PartitionedKVStore::put(uint64_t key, const std::string &s) {
+    route(key)->put(key, KVStore::encodeValue(s));
+}
+
+std::string PartitionedKVStore::get(uint64_t key) {
+    return KVStore::decodeValue(route(key)->get(key));
+}
+
+bool PartitionedKVStore::del(uint64_t key) {
+    return route(key)->del(key);
+}
+
+void PartitionedKVStore::merge(uint64_t key, const std::string &operand) {
+    route(key)->merge(key, operand);
+}
+
+void PartitionedKVStore::delete_range(uint64_t key1, uint64_t key2) {
+    for (const auto &[lo, hi]:KVStore::signedRanges(key1, key2)) {
+        if (split_keys.empty()) {
+            // Keys of any range are spread over every partition by hash.
+            for (auto *partition:partitions) {
+                partition->deleteRange(lo, hi);
+            }
+            continue;
+        }
+        auto first = std::upper_bound(split_keys.begin(), split_keys.end(), lo);
+        auto last = std::upper_bound(split_keys.begin(), split_keys.end(), hi);
+        for (auto p = std::distance(split_keys.begin(), first); p <= std::distance(split_keys.begin(), last); p++) {
+            partitions[p]->deleteRange(lo, hi);
+        }
+    }
+}
+
+void PartitionedKVStore::reset() {
+    for (auto *partition:partitions) {
+        partition->reset();
+    }
+}
+
+size_t PartitionedKVStore::partitionsCount() const {
+    return partitions.size();
+}
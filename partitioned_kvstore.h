@@ -0,0 +1,57 @@
+#ifndef LSMTREE_PARTITIONED_KVSTORE_H
+#define LSMTREE_PARTITIONED_KVSTORE_H
+
+#include "kvstore_api.h"
+#include "lsmtree/LSMTree.h"
+#include <vector>
+#include <exception>
+
+class PartitionLayoutMismatchException : public std::exception {
+};
+
+/*
+ * KVStore made up of several independent LSMTrees, so that writes to different partitions never contend,
+ * and each partition persists its memtables and compacts on its own flush worker.
+ * Partition i lives in sub-directory "p<i>" of dir. Keys are routed by hash, or by range if split keys are given.
+ * Layout of partitions is recorded in dir, reopening with another layout throws PartitionLayoutMismatchException.
+ */
+class PartitionedKVStore : public KVStoreAPI {
+private:
+    std::vector<LSMTree *> partitions;
+    std::vector<uint64_t> split_keys; // Empty if keys are routed by hash.
+
+    LSMTree *route(uint64_t key);
+
+    void checkLayout(const path &data_dir);
+
+    void open(const std::string &dir, size_t partitions_count, const Options &options);
+
+public:
+    // Route keys by hash.
+    PartitionedKVStore(const std::string &dir, size_t partitions_count, const Options &options = Options{});
+
+    // Route keys by range, partition i holds keys in [split_keys[i - 1], split_keys[i]).
+    PartitionedKVStore(const std::string &dir, const std::vector<uint64_t> &split_keys,
+                       const Options &options = Options{});
+
+    ~PartitionedKVStore();
+
+    void put(uint64_t key, const std::string &s) override;
+
+    std::string get(uint64_t key) override;
+
+    bool del(uint64_t key) override;
+
+    // See KVStore::merge.
+    void merge(uint64_t key, const std::string &operand);
+
+    // Delete every key in [key1, key2] from every partition which may hold one.
+    void delete_range(uint64_t key1, uint64_t key2);
+
+    void reset() override;
+
+    [[nodiscard]] size_t partitionsCount() const;
+};
+
+
+#endif //LSMTREE_PARTITIONED_KVSTORE_H
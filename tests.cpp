@@ -5,9 +5,21 @@
 #include <filesystem>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <map>
+#include <random>
 #include <ctime>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <sys/resource.h>
+#include <unistd.h>
 #include "memtable/MemTable.h"
 #include "disktable/DiskTable.h"
+#include "disktable/CompactionPolicy.h"
+#include "lsmtree/LSMTree.h"
+#include "partitioned_kvstore.h"
+#include "kvstore.h"
 
 using namespace std::filesystem;
 
@@ -108,21 +120,17 @@ bool test_SSTable_behavior() {
 
     auto *h = s.getHeader();
 
-    if (h->key_min != 1 || h->entries_count != 4 || h->key_max != 4 || h->index_offset != 32 + (25 * 4 + 12 + 5 + 4)) {
+    if (h->key_min != 1 || h->entries_count != 4 || h->key_max != 4 || h->index_offset != SSTABLE_HEADER_SIZE + (18 + 11 + 7 + 10)) {
         return false;
     }
 
     auto &index = *s.getIndex();
 
+    // Only one restart point for 4 entries.
     if (
+            index.size() != 1 ||
             index[0].key != 1 ||
-            index[0].offset != 32 ||
-            index[1].key != 2 ||
-            index[1].offset != 69 ||
-            index[2].key != 3 ||
-            index[2].offset != 99 ||
-            index[3].key != 4 ||
-            index[3].offset != 124
+            index[0].offset != SSTABLE_HEADER_SIZE
             ) {
         return false;
     }
@@ -145,22 +153,16 @@ bool test_SSTable_fileIO() {
 
     auto *h = s.getHeader();
 
-    if (h->key_min != 1 || h->entries_count != 4 || h->key_max != 4 || h->index_offset != 32 + (25 * 4 + 12 + 5 + 4)) {
+    if (h->key_min != 1 || h->entries_count != 4 || h->key_max != 4 || h->index_offset != SSTABLE_HEADER_SIZE + (18 + 11 + 7 + 10)) {
         return false;
     }
 
     auto &index = *s.getIndex();
 
     if (
-            index.size() != 4 ||
+            index.size() != 1 ||
             index[0].key != 1 ||
-            index[0].offset != 32 ||
-            index[1].key != 2 ||
-            index[1].offset != 69 ||
-            index[2].key != 3 ||
-            index[2].offset != 99 ||
-            index[3].key != 4 ||
-            index[3].offset != 124
+            index[0].offset != SSTABLE_HEADER_SIZE
             ) {
         return false;
     }
@@ -240,6 +242,1214 @@ bool test_DiskTableNode_behavior() {
     return true;
 }
 
+bool test_RestartIndex_floor() {
+    auto index = RestartIndex{};
+    for (long long i = 0; i < 100; i++) {
+        index.push_back(i * 16, i * 100);
+    }
+    if (index.floor(-1) != RestartIndex::npos) {
+        return false;
+    }
+    for (long long key = 0; key < 1700; key++) {
+        auto p = index.floor(key);
+        auto expected = static_cast<size_t>(std::min(key / 16, 99LL));
+        if (p != expected || index.offsetAt(p) != expected * 100) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool test_learned_index() {
+    auto data = SSTableData{};
+    for (long long i = 0; i < 5000; i++) {
+        // Dense keys with a gap in the middle, so more than one segment is needed.
+        auto key = i < 2500 ? i * 3 : 1000000 + i * 7;
+        data.push_back({false, 1, key, std::to_string(key)});
+    }
+    auto options = Options{};
+    options.learned_index = true;
+    auto t = SSTable{};
+    t.fillData(data, options);
+    t.writeToDisk("testf.bin");
+    auto node = DiskTableNode{path{"testf.bin"}};
+    for (const auto &item:data) {
+        if (node.getEntry(item.key).value != item.value || node.valid(node.getEntry(item.key + 1))) {
+            remove("testf.bin");
+            return false;
+        }
+    }
+    auto l = std::unique_ptr<LearnedIndex>{SSTable{"testf.bin"}.readLearnedIndex()};
+    remove("testf.bin");
+    return l != nullptr && l->segmentsCount() < 10;
+}
+
+bool test_partitioned_metadata() {
+    auto data = SSTableData{};
+    for (long long i = 0; i < 20000; i++) {
+        data.push_back({false, 1, i * 2, std::to_string(i)});
+    }
+    auto options = Options{};
+    options.partitioned_metadata = true;
+    options.metadata_partition_restarts = 8;
+    auto t = SSTable{};
+    t.fillData(data, options);
+    t.writeToDisk("testf.bin");
+    auto ok = true;
+    {
+        auto cache = std::make_shared<BlockCache>(64 * 1024, 4);
+        auto node = DiskTableNode{path{"testf.bin"}, cache};
+        for (const auto &item:data) {
+            ok = ok && node.mightIn(item.key) && node.getEntry(item.key).value == item.value &&
+                 !node.valid(node.getEntry(item.key + 1));
+        }
+        ok = ok && !node.mightIn(-1) && node.getFilter() == nullptr;
+        ok = ok && cache->usage() > 0 && cache->usage() <= cache->capacity();
+        auto *head = SSTable{"testf.bin"}.readPartitionedFilterHead();
+        ok = ok && head != nullptr && head->first_keys.size() == (20000 + 8 * 16 - 1) / (8 * 16);
+        delete head;
+    }
+    remove("testf.bin");
+    return ok;
+}
+
+bool test_LSMTree_concurrent_get() {
+    auto dir = path{"concurrent_test_data"};
+    remove_all(dir);
+    auto ok = std::atomic<bool>{true};
+    {
+        auto tree = LSMTree{dir};
+        const long long max = 12000; // About 12 MB, several flushes and compactions.
+        auto written = std::atomic<long long>{-1};
+        auto value_of = [](long long i) { return std::string(1000, static_cast<char>('a' + i % 26)); };
+        auto readers = std::vector<std::thread>{};
+        for (int r = 0; r < 4; r++) {
+            readers.emplace_back([&, r] {
+                auto gen = std::mt19937_64{static_cast<unsigned long long>(r)};
+                while (written.load() < max - 1) {
+                    auto w = written.load();
+                    if (w < 0) {
+                        continue;
+                    }
+                    auto k = static_cast<long long>(gen() % (w + 1));
+                    if (tree.get(k) != value_of(k)) {
+                        ok = false;
+                    }
+                }
+            });
+        }
+        for (long long i = 0; i < max; i++) {
+            tree.put(i, value_of(i));
+            written.store(i);
+        }
+        for (auto &t:readers) {
+            t.join();
+        }
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_LSMTree_row_cache() {
+    auto cache = RowCache{4 * 200, 4};
+    uint64_t epoch = 0;
+    auto value = std::string{};
+    if (cache.lookup(1, value, epoch)) {
+        return false;
+    }
+    cache.insert(1, "one", epoch);
+    if (!cache.lookup(1, value, epoch) || value != "one") {
+        return false;
+    }
+    // An insert racing with an erase is dropped.
+    cache.lookup(2, value, epoch);
+    cache.erase(2);
+    cache.insert(2, "stale", epoch);
+    if (cache.lookup(2, value, epoch)) {
+        return false;
+    }
+    for (long long k = 0; k < 100; k++) {
+        cache.lookup(k, value, epoch);
+        cache.insert(k, std::string(50, 'x'), epoch);
+    }
+    if (cache.usage() > 4 * 200) {
+        return false;
+    }
+    auto dir = path{"row_cache_test_data"};
+    remove_all(dir);
+    auto ok = true;
+    {
+        auto options = Options{};
+        options.row_cache_bytes = 1 << 20;
+        auto tree = LSMTree{dir, options};
+        const long long max = 3000; // About 3 MB, at least one flush.
+        for (long long i = 0; i < max; i++) {
+            tree.put(i, std::string(1000, 'a'));
+        }
+        ok = ok && tree.get(1) == std::string(1000, 'a') && tree.get(1) == std::string(1000, 'a');
+        ok = ok && tree.get(max + 1).empty() && tree.get(max + 1).empty();
+        tree.put(1, "b");
+        ok = ok && tree.get(1) == "b";
+        ok = ok && tree.del(2) && tree.get(2).empty();
+        tree.put(max + 1, "c");
+        ok = ok && tree.get(max + 1) == "c";
+        auto numbers = [&dir] {
+            auto found = std::vector<long long>{};
+            for (const auto &f:recursive_directory_iterator{dir}) {
+                if (f.path().extension() == ".bin") {
+                    found.push_back(atoll(f.path().stem().c_str()));
+                }
+            }
+            return found;
+        };
+        auto before = numbers();
+        tree.reset();
+        ok = ok && tree.get(3).empty();
+        // Sstables after reset never take numbers of old ones, which readers of old versions may still remove.
+        for (long long i = 0; i < max; i++) {
+            tree.put(i, std::string(1000, 'a'));
+        }
+        auto after = numbers();
+        ok = ok && !before.empty() && !after.empty() &&
+             *std::min_element(after.begin(), after.end()) > *std::max_element(before.begin(), before.end());
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_key_filter() {
+    auto filter = CuckooFilter{1000};
+    long long k = 0;
+    while (filter.add(k)) {
+        k++;
+    }
+    // Nothing added before it gets full is lost.
+    for (long long i = 0; i <= k; i++) {
+        if (!filter.mightContain(i)) {
+            return false;
+        }
+    }
+    if (k < 1000 || !filter.full()) {
+        return false;
+    }
+    auto dir = path{"key_filter_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.key_filter = true;
+    auto ok = true;
+    const long long max = 3000; // About 3 MB, at least one flush.
+    {
+        auto tree = LSMTree{dir, options};
+        for (long long i = 0; i < max; i += 2) {
+            tree.put(i, std::string(2000, 'a'));
+        }
+        ok = ok && tree.get(2) == std::string(2000, 'a') && tree.get(3).empty() && !tree.del(5) && tree.del(4);
+    }
+    ok = ok && exists(dir / "keys.filter");
+    {
+        // Loaded from keys.filter.
+        auto tree = LSMTree{dir, options};
+        ok = ok && !exists(dir / "keys.filter") && tree.get(2) == std::string(2000, 'a') && tree.get(4).empty();
+    }
+    remove(dir / "keys.filter");
+    {
+        // Built by reading sstables.
+        auto tree = LSMTree{dir, options};
+        for (long long i = 0; i < max; i += 2) {
+            ok = ok && tree.get(i) == (i == 4 ? "" : std::string(2000, 'a')) && tree.get(i + 1).empty();
+        }
+    }
+    {
+        // A full filter is not saved, it's rebuilt on open.
+        auto disk = DiskTable{dir, options};
+        auto keys = SSTableData{};
+        for (long long i = 0; disk.keyFilter()->add(keys); i++) {
+            keys.assign(1, SSTableDataEntry{false, 1, max + i, "k"});
+        }
+    }
+    ok = ok && !exists(dir / "keys.filter");
+    remove_all(dir);
+    return ok;
+}
+
+bool test_filter_bits_per_level() {
+    auto dir = path{"filter_bits_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.filter_bits_per_level = true;
+    auto ok = true;
+    {
+        auto disk = DiskTable{dir, options};
+        const size_t levels = 5;
+        double weighted = 0, total = 0;
+        for (size_t i = 0; i < levels; i++) {
+            auto bits = disk.filterBitsPerKey(i, levels);
+            ok = ok && (i == 0 || bits < disk.filterBitsPerKey(i - 1, levels));
+            auto capacity = options.level0_limit * std::pow(static_cast<double>(options.level_factor), i);
+            weighted += bits * capacity;
+            total += capacity;
+        }
+        ok = ok && std::abs(weighted / total - options.filter_bits_per_key) < 1e-6;
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_leveled_compaction() {
+    auto dir = path{"leveled_compaction_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.compaction_style = CompactionStyle::Leveled;
+    auto ok = true;
+    auto expected = std::map<long long, std::string>{};
+    {
+        auto disk = DiskTable{dir, options};
+        for (long long round = 0; round < 60; round++) {
+            auto m = MemTable{};
+            for (long long i = 0; i < 200; i++) {
+                auto key = (round * 200 + i) * 7919 % 5000;
+                auto value = std::to_string(round) + "_" + std::to_string(key);
+                m.put(key, value);
+                expected[key] = value;
+            }
+            disk.persistent(m);
+            auto version = disk.current();
+            size_t limit = 2;
+            for (size_t level = 0; level < version->size(); level++, limit *= 2) {
+                const auto &nodes = (*version)[level];
+                ok = ok && nodes.size() <= limit;
+                if (level == 0) {
+                    continue;
+                }
+                // Sstables of a level other than level 0 never overlap.
+                for (const auto &a:nodes) {
+                    for (const auto &b:nodes) {
+                        ok = ok && (a == b || !a->intersect(*b));
+                    }
+                }
+            }
+        }
+        for (const auto &[key, value]:expected) {
+            auto res = disk.get(key);
+            ok = ok && res.success && res.data == value;
+        }
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_dynamic_level_bytes() {
+    auto dir = path{"dynamic_level_bytes_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.compaction_style = CompactionStyle::Leveled;
+    options.dynamic_level_bytes = true;
+    options.max_levels = 4;
+    options.level_factor = 4;
+    options.memtable_size = 100 * 1000;
+    options.sstable_size = 100 * 1000;
+    auto ok = true;
+    auto expected = std::map<long long, std::string>{};
+    {
+        auto disk = DiskTable{dir, options};
+        auto policy = LeveledCompaction{options};
+        for (long long round = 0; round < 80; round++) {
+            auto m = MemTable{};
+            for (long long i = 0; i < 100; i++) {
+                auto key = (round * 100 + i) * 7919 % 20000;
+                auto value = std::to_string(round) + std::string(1000, 'd');
+                m.put(key, value);
+                expected[key] = value;
+            }
+            disk.persistent(m);
+            auto version = disk.current();
+            size_t base_level = 0;
+            auto targets = policy.levelTargets(*version, base_level);
+            ok = ok && version->size() == options.max_levels && (*version)[0].size() <= options.level0_limit;
+            for (size_t level = 1; level + 1 < version->size(); level++) {
+                ok = ok && LeveledCompaction::bytesOf((*version)[level]) <= targets[level];
+                ok = ok && (level >= base_level || (*version)[level].empty());
+            }
+        }
+        // Levels above last one take at most 1 / (level_factor - 1) of it.
+        auto version = disk.current();
+        auto last = LeveledCompaction::bytesOf(version->back());
+        size_t upper = 0;
+        for (size_t level = 1; level + 1 < version->size(); level++) {
+            upper += LeveledCompaction::bytesOf((*version)[level]);
+        }
+        ok = ok && version->back().size() > 1 && upper * (options.level_factor - 1) <= last;
+        for (const auto &[key, value]:expected) {
+            auto res = disk.get(key);
+            ok = ok && res.success && res.data == value;
+        }
+    }
+    remove_all(dir);
+    for (size_t factor:{0, 1}) {
+        // Taken as the least level_factor that shrinks levels going up.
+        options.level_factor = factor;
+        options.filter_bits_per_level = true;
+        {
+            auto disk = DiskTable{dir, options};
+            for (long long round = 0; round < 20; round++) {
+                auto m = MemTable{};
+                for (long long i = 0; i < 100; i++) {
+                    m.put(round * 100 + i, std::string(1000, 'f'));
+                }
+                disk.persistent(m);
+            }
+            ok = ok && disk.get(0).success && disk.get(1999).success && disk.filterBitsPerKey(0, 3) > 0;
+        }
+        remove_all(dir);
+    }
+    return ok;
+}
+
+bool test_trivial_move() {
+    auto dir = path{"trivial_move_test_data"};
+    remove_all(dir);
+    auto ok = true;
+    {
+        auto disk = DiskTable{dir};
+        auto first_write = file_time_type{};
+        // Sequential keys, no sstable ever overlaps another.
+        for (long long round = 0; round < 40; round++) {
+            auto m = MemTable{};
+            for (long long i = 0; i < 100; i++) {
+                m.put(round * 100 + i, std::to_string(round * 100 + i));
+            }
+            disk.persistent(m);
+            if (round == 0) {
+                first_write = last_write_time(disk.current()->front().front()->getFile());
+            }
+        }
+        auto version = disk.current();
+        size_t sstables = 0;
+        for (const auto &level:*version) {
+            for (const auto &node:level) {
+                sstables++;
+                // Sstable of first round is moved down, not rewritten.
+                if (node->mightIn(0)) {
+                    ok = ok && &level != &version->front() && last_write_time(node->getFile()) == first_write;
+                }
+            }
+        }
+        ok = ok && version->size() > 2 && sstables == 40;
+        for (long long key = 0; key < 4000; key += 7) {
+            auto res = disk.get(key);
+            ok = ok && res.success && res.data == std::to_string(key);
+        }
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_tombstone_gc() {
+    auto dir = path{"tombstone_gc_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.compaction_style = CompactionStyle::Leveled;
+    options.tombstone_compaction_ratio = 0.5;
+    auto ok = true;
+    {
+        auto disk = DiskTable{dir, options};
+        for (long long round = 0; round < 20; round++) {
+            auto m = MemTable{};
+            for (long long i = 0; i < 100; i++) {
+                auto key = (round % 10) * 100 + i;
+                if (round < 10) {
+                    m.put(key, std::string(1000, 'g'));
+                } else {
+                    m.remove(key);
+                }
+            }
+            disk.persistent(m);
+        }
+        // Keep queue table going, new keys on top of deleted ones.
+        for (long long round = 0; round < 4; round++) {
+            auto m = MemTable{};
+            for (long long i = 0; i < 100; i++) {
+                m.put(1000 + round * 100 + i, std::string(1000, 'g'));
+            }
+            disk.persistent(m);
+        }
+        auto version = disk.current();
+        size_t entries = 0, tombstones = 0;
+        for (const auto &level:*version) {
+            for (const auto &node:level) {
+                entries += node->entriesCount();
+                tombstones += node->tombstonesCount();
+            }
+        }
+        // Deleted keys and their tombstones are gone once compacted into last level.
+        ok = ok && tombstones == 0 && entries == 400;
+        for (long long key = 0; key < 1400; key += 3) {
+            auto res = disk.get(key);
+            ok = ok && res.success == (key >= 1000);
+        }
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_delete_range() {
+    auto dir = path{"delete_range_test_data"};
+    auto ok = true;
+    for (auto style:{CompactionStyle::Leveled, CompactionStyle::Tiered}) {
+        remove_all(dir);
+        auto options = Options{};
+        options.compaction_style = style;
+        auto expected = std::map<long long, std::string>{};
+        auto check = [&ok, &expected](LSMTree &tree) {
+            for (long long k = 0; k < 9000; k += 7) {
+                auto e = expected.find(k);
+                ok = ok && tree.get(k) == (e == expected.end() ? "" : e->second);
+            }
+            auto result = std::list<std::pair<long long, std::string>>{};
+            tree.scan(0, 9000, result);
+            ok = ok && result.size() == expected.size() &&
+                 std::equal(result.begin(), result.end(), expected.begin(), [](const auto &a, const auto &b) {
+                     return a.first == b.first && a.second == b.second;
+                 });
+        };
+        {
+            auto tree = LSMTree{dir, options};
+            const long long max = 6000; // About 6 MB, several flushes and compactions.
+            for (long long i = 0; i < max; i++) {
+                tree.put(i, std::string(1000, 'a' + i % 26));
+                expected[i] = std::string(1000, 'a' + i % 26);
+            }
+            // Covers keys in memtable and in sstables of several levels.
+            tree.deleteRange(1000, 5990);
+            expected.erase(expected.lower_bound(1000), expected.upper_bound(5990));
+            tree.put(1500, "back");
+            expected[1500] = "back";
+            check(tree);
+            // Push range tombstone down through compactions.
+            for (long long i = max; i < 9000; i++) {
+                tree.put(i, std::string(1000, 'b'));
+                expected[i] = std::string(1000, 'b');
+            }
+            tree.deleteRange(-10, 10);
+            expected.erase(expected.begin(), expected.upper_bound(10));
+            check(tree);
+        }
+        auto tree = LSMTree{dir, options};
+        check(tree);
+    }
+    remove_all(dir);
+    {
+        // Unsigned ranges of KVStore up to UINT64_MAX, or crossing 2^63, delete every key in them.
+        auto store = KVStore{dir.string()};
+        const auto sign_bit = static_cast<uint64_t>(1) << 63;
+        auto keys = std::vector<uint64_t>{0, 5, 9, sign_bit - 1, sign_bit, sign_bit + 7, UINT64_MAX};
+        auto put_all = [&store, &keys] {
+            for (auto k:keys) {
+                store.put(k, std::to_string(k));
+            }
+        };
+        auto present = [&store](uint64_t k) { return store.get(k) == std::to_string(k); };
+        put_all();
+        store.delete_range(6, UINT64_MAX);
+        ok = ok && present(0) && present(5) && !present(9) && !present(sign_bit - 1) && !present(sign_bit) &&
+             !present(UINT64_MAX);
+        put_all();
+        store.delete_range(sign_bit - 1, sign_bit + 7);
+        ok = ok && present(9) && !present(sign_bit - 1) && !present(sign_bit) && !present(sign_bit + 7) &&
+             present(UINT64_MAX);
+        put_all();
+        store.delete_range(0, UINT64_MAX);
+        ok = ok && std::none_of(keys.begin(), keys.end(), present);
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_merge_operator() {
+    auto dir = path{"merge_operator_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.memtable_size = 64 << 10; // Every round is flushed, operands of a key spread over sstables.
+    options.merge_operator = [](const std::string *existing_value, const std::string &operand) {
+        return std::to_string((existing_value != nullptr ? std::stoll(*existing_value) : 0) + std::stoll(operand));
+    };
+    auto ok = true;
+    auto expected = std::map<long long, std::string>{};
+    auto check = [&ok, &expected](LSMTree &tree) {
+        for (long long k = 0; k < 2000; k++) {
+            auto e = expected.find(k);
+            ok = ok && tree.get(k) == (e == expected.end() ? "" : e->second);
+        }
+        auto result = std::list<std::pair<long long, std::string>>{};
+        tree.scan(0, 2000, result);
+        ok = ok && result.size() == expected.size() &&
+             std::equal(result.begin(), result.end(), expected.begin(), [](const auto &a, const auto &b) {
+                 return a.first == b.first && a.second == b.second;
+             });
+    };
+    {
+        auto tree = LSMTree{dir, options};
+        for (long long round = 0; round < 30; round++) {
+            for (long long k = 0; k < 2000; k++) {
+                tree.merge(k, std::to_string(k % 5));
+                auto e = expected.find(k);
+                expected[k] = std::to_string((e != expected.end() ? std::stoll(e->second) : 0) + k % 5);
+                if (round % 10 == 9 && k % 7 == 0) {
+                    tree.put(k, "100");
+                    expected[k] = "100";
+                }
+            }
+            if (round == 15) {
+                for (long long k = 0; k < 2000; k += 11) {
+                    tree.del(k);
+                    expected.erase(k);
+                }
+            }
+            if (round == 20) {
+                tree.deleteRange(500, 599);
+                expected.erase(expected.lower_bound(500), expected.upper_bound(599));
+            }
+            if (round % 10 == 5) {
+                check(tree);
+            }
+        }
+        check(tree);
+    }
+    auto tree = LSMTree{dir, options};
+    check(tree);
+    remove_all(dir);
+    return ok;
+}
+
+bool test_rate_limiter() {
+    using Clock=std::chrono::steady_clock;
+    auto seconds_since = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    auto ok = true;
+    {
+        auto limiter = RateLimiter{1 << 20};
+        auto start = Clock::now();
+        limiter.request(512 << 10, RateLimiter::Priority::Low);
+        ok = ok && seconds_since(start) >= 0.4 && limiter.totalBytes() == 512 << 10;
+    }
+    {
+        // A flush arriving during a long compaction request is granted before it.
+        auto limiter = RateLimiter{1 << 20};
+        auto low_done = std::atomic<bool>{false};
+        auto low = std::thread{[&limiter, &low_done]() {
+            limiter.request(1 << 20, RateLimiter::Priority::Low);
+            low_done = true;
+        }};
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        limiter.request(64 << 10, RateLimiter::Priority::High);
+        ok = ok && !low_done;
+        low.join();
+    }
+    auto dir = path{"rate_limiter_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.memtable_size = 64 << 10;
+    options.rate_limiter = std::make_shared<RateLimiter>(64 << 20, true);
+    auto value_of = [](long long k, long long round) {
+        return std::to_string(k * round) + std::string(k % 50, 'r');
+    };
+    {
+        // Flushes are installed along with compaction running on its worker thread.
+        auto tree = LSMTree{dir, options};
+        for (long long round = 1; round <= 3; round++) {
+            for (long long k = 0; k < 20000; k++) {
+                tree.put(k, value_of(k, round));
+            }
+            for (long long k = 0; k < 20000; k += 7) {
+                ok = ok && tree.get(k) == value_of(k, round);
+            }
+        }
+        auto rate = options.rate_limiter->bytesPerSecond();
+        ok = ok && options.rate_limiter->totalBytes() > 0 && rate >= (64 << 20) / 10 && rate <= 64 << 20;
+    }
+    // Debt of a closed tree is forgotten.
+    ok = ok && options.rate_limiter->bytesPerSecond() == (64 << 20) / 10;
+    {
+        auto tree = LSMTree{dir};
+        for (long long k = 0; k < 20000; k += 3) {
+            ok = ok && tree.get(k) == value_of(k, 3);
+        }
+    }
+    remove_all(dir);
+    {
+        // Writes wait for a compaction slower than flushes, instead of piling sstables up in level 0.
+        auto slow = Options{};
+        slow.memtable_size = 16 << 10;
+        slow.level0_stop_factor = 2;
+        slow.rate_limiter = std::make_shared<RateLimiter>(1 << 20);
+        auto tree = LSMTree{dir, slow};
+        size_t most = 0;
+        for (long long i = 0; i < 10000; i++) {
+            tree.put(i * 7 % 1000, std::string(100, 's'));
+            if (i % 100 == 0) {
+                most = std::max<size_t>(most, std::distance(directory_iterator{dir / "0"}, directory_iterator{}));
+            }
+        }
+        // Level 0 may also hold files of sstables just compacted, until they are released.
+        ok = ok && most <= 2 * (slow.level0_stop_factor * slow.level0_limit + 1);
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_tiered_compaction() {
+    auto dir = path{"tiered_compaction_test_data"};
+    auto ok = true;
+    // Sstables written, by clock of the last one, for the same writes under style.
+    auto files_written = [&ok, &dir](CompactionStyle style) {
+        remove_all(dir);
+        auto options = Options{};
+        options.compaction_style = style;
+        auto expected = std::map<long long, std::string>{};
+        size_t written = 0;
+        {
+            auto disk = DiskTable{dir, options};
+            for (long long round = 0; round < 60; round++) {
+                auto m = MemTable{};
+                for (long long i = 0; i < 200; i++) {
+                    auto key = (round * 200 + i) * 7919 % 5000;
+                    auto value = std::to_string(round) + "_" + std::to_string(key) + std::string(1000, 't');
+                    m.put(key, value);
+                    expected[key] = value;
+                }
+                disk.persistent(m);
+            }
+            for (const auto &level:*disk.current()) {
+                for (const auto &node:level) {
+                    written = std::max(written, node->number());
+                }
+            }
+        }
+        // Later runs of a level are still found first after manifest is replayed.
+        auto disk = DiskTable{dir, options};
+        for (const auto &[key, value]:expected) {
+            auto res = disk.get(key);
+            ok = ok && res.success && res.data == value;
+        }
+        return written;
+    };
+    auto tiered = files_written(CompactionStyle::Tiered);
+    auto leveled = files_written(CompactionStyle::Leveled);
+    ok = ok && tiered < leveled;
+    remove_all(dir);
+    // Small runs arriving after a large one are merged among themselves, the large run is left as it is.
+    auto options = Options{};
+    options.compaction_style = CompactionStyle::Tiered;
+    auto expected = std::map<long long, std::string>{};
+    auto large = std::set<size_t>{};
+    {
+        auto disk = DiskTable{dir, options};
+        for (long long round = 0; round < 63; round++) {
+            auto m = MemTable{};
+            for (long long i = 0; i < (round < 3 ? 1000 : 10); i++) {
+                auto key = round < 3 ? i * 3 + round : (round * 10 + i) * 7919 % 3000;
+                auto value = std::to_string(round) + std::string(round < 3 ? 1000 : 10, 'l');
+                m.put(key, value);
+                expected[key] = value;
+            }
+            disk.persistent(m);
+            if (round == 2) {
+                for (const auto &node:(*disk.current())[1]) {
+                    large.insert(node->number());
+                }
+            }
+        }
+        auto version = disk.current();
+        for (auto number:large) {
+            ok = ok && std::any_of((*version)[1].begin(), (*version)[1].end(), [number](const auto &node) {
+                return node->number() == number;
+            });
+        }
+    }
+    {
+        // Runs merged at the end of level 1 still take precedence over the large one after replay.
+        auto disk = DiskTable{dir, options};
+        for (const auto &[key, value]:expected) {
+            auto res = disk.get(key);
+            ok = ok && res.success && res.data == value;
+        }
+    }
+    ok = ok && !large.empty();
+    remove_all(dir);
+    return ok;
+}
+
+bool test_xor_filter() {
+    auto keys = std::vector<long long>{};
+    for (long long i = 0; i < 10000; i++) {
+        keys.push_back(i * 3);
+    }
+    auto options = Options{};
+    options.filter_type = FilterType::Xor;
+    auto *f = SSTableFilter::build(keys, options);
+    auto false_positives = 0;
+    for (long long i = 0; i < 30000; i++) {
+        if (i % 3 == 0 && !f->mightContain(i)) {
+            delete f;
+            return false;
+        }
+        false_positives += i % 3 != 0 && f->mightContain(i);
+    }
+    // 8 bits fingerprints, about 1 / 256 of 20000 absent keys.
+    auto ok = false_positives < 200 && f->size_bytes() < keys.size() * 10 / 8;
+    auto ss = std::stringstream{};
+    f->write(ss);
+    ok = ok && ss.str().size() == f->size_bytes();
+    auto *g = SSTableFilter::read(ss);
+    for (long long i = 0; i < 30000; i++) {
+        ok = ok && f->mightContain(i) == g->mightContain(i);
+    }
+    delete f;
+    delete g;
+    // Duplicate keys are built into the filter once.
+    auto duplicated = std::vector<long long>{1, 5, 5, 9, 1, 5};
+    auto d = XorFilter<uint8_t>{duplicated};
+    ok = ok && d.mightContain(1) && d.mightContain(5) && d.mightContain(9);
+    return ok;
+}
+
+bool test_range_filter() {
+    // Clusters of keys with wide gaps between them.
+    auto keys = std::vector<long long>{};
+    for (long long c = 0; c < 100; c++) {
+        for (long long i = 0; i < 50; i++) {
+            keys.push_back(c * 100000 + i * 7);
+        }
+    }
+    auto f = RangeFilter{keys, 10};
+    auto gen = std::mt19937_64{0};
+    auto skipped = 0;
+    for (int i = 0; i < 10000; i++) {
+        auto lo = static_cast<long long>(gen() % 10000000);
+        auto hi = lo + static_cast<long long>(gen() % 1000);
+        auto p = std::lower_bound(keys.begin(), keys.end(), lo);
+        auto contains = p != keys.end() && *p <= hi;
+        if (contains && !f.mightContain(lo, hi)) {
+            return false;
+        }
+        skipped += !f.mightContain(lo, hi);
+    }
+    // Most short ranges fall into gaps.
+    if (skipped <= 9000) {
+        return false;
+    }
+    // Compaction never leaves out an sstable whose key range overlaps, even if keys merged fall into its gaps.
+    auto dir = path{"range_filter_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.range_filter = true;
+    auto ok = true;
+    {
+        auto disk = DiskTable{dir, options};
+        for (long long base:{0LL, 0LL, 0LL, 500000LL, 500000LL, 500000LL}) {
+            auto m = MemTable{};
+            for (long long i = 0; i < 50; i++) {
+                m.put(base + i, "v");
+                if (base == 0) {
+                    m.put(1000000 + i, "v");
+                }
+            }
+            disk.persistent(m);
+        }
+        auto version = disk.current();
+        for (size_t level = 1; level < version->size(); level++) {
+            for (const auto &a:(*version)[level]) {
+                for (const auto &b:(*version)[level]) {
+                    ok = ok && (a == b || !a->intersect(*b));
+                }
+            }
+        }
+        ok = ok && disk.get(500010).success && disk.get(1000010).success;
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_LSMTree_scan() {
+    auto dir = path{"scan_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.range_filter = true;
+    auto ok = true;
+    {
+        auto tree = LSMTree{dir, options};
+        auto expected = std::map<long long, std::string>{};
+        const long long max = 6000; // About 6 MB, several flushes and a compaction.
+        for (long long i = 0; i < max; i++) {
+            auto k = i * 3 % max;
+            tree.put(k, std::string(1000, 'a' + i % 26));
+            expected[k] = std::string(1000, 'a' + i % 26);
+        }
+        for (long long k = 0; k < max; k += 5) {
+            tree.del(k);
+            expected.erase(k);
+        }
+        tree.put(10, "new");
+        expected[10] = "new";
+        auto check = [&](long long lo, long long hi) {
+            auto result = std::list<std::pair<long long, std::string>>{};
+            tree.scan(lo, hi, result);
+            auto p = result.begin();
+            for (auto e = expected.lower_bound(lo); e != expected.end() && e->first <= hi; e++, p++) {
+                if (p == result.end() || p->first != e->first || p->second != e->second) {
+                    return false;
+                }
+            }
+            return p == result.end();
+        };
+        ok = ok && check(0, max) && check(7, 29) && check(max - 3, max + 100) && check(-5, -1) && check(3, 3);
+    }
+    remove_all(dir);
+    {
+        // Unsigned keys of KVStore are scanned in unsigned order, also across 2^63.
+        auto store = KVStore{dir.string()};
+        const auto sign_bit = static_cast<uint64_t>(1) << 63;
+        auto keys = std::vector<uint64_t>{0, 5, sign_bit - 1, sign_bit, sign_bit + 7, UINT64_MAX};
+        for (auto k:keys) {
+            store.put(k, std::to_string(k));
+        }
+        auto check = [&store, &keys](uint64_t lo, uint64_t hi) {
+            auto result = std::list<std::pair<uint64_t, std::string>>{};
+            store.scan(lo, hi, result);
+            auto p = result.begin();
+            for (auto k:keys) {
+                if (k < lo || k > hi) {
+                    continue;
+                }
+                if (p == result.end() || p->first != k || p->second != std::to_string(k)) {
+                    return false;
+                }
+                p++;
+            }
+            return p == result.end();
+        };
+        ok = ok && check(0, UINT64_MAX) && check(1, sign_bit) && check(sign_bit - 1, sign_bit + 7) &&
+             check(sign_bit, UINT64_MAX) && check(6, 4);
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_manifest() {
+    auto dir = path{"manifest_test_data"};
+    remove_all(dir);
+    auto ok = true;
+    const long long max = 6000; // About 12 MB, several flushes and compactions.
+    auto check = [&ok, &dir](long long count) {
+        auto tree = LSMTree{dir};
+        for (long long i = 0; i < count; i += 7) {
+            ok = ok && tree.get(i) == std::to_string(i) + std::string(2000, 'm');
+        }
+        ok = ok && tree.get(count + 1).empty();
+    };
+    {
+        auto tree = LSMTree{dir};
+        for (long long i = 0; i < max; i++) {
+            tree.put(i, std::to_string(i) + std::string(2000, 'm'));
+        }
+    }
+    ok = ok && exists(dir / "MANIFEST") && !exists(dir / "sstable.lock");
+    check(max);
+    {
+        // A torn record is dropped, and records appended after it are replayed.
+        auto os = std::ofstream{dir / "MANIFEST", ios_base::out | ios_base::binary | ios_base::app};
+        os << "torn";
+    }
+    {
+        auto tree = LSMTree{dir};
+        for (long long i = max; i < 2 * max; i++) {
+            tree.put(i, std::to_string(i) + std::string(2000, 'm'));
+        }
+    }
+    check(2 * max);
+    {
+        // Length of a corrupt record claims far more than the log holds.
+        auto os = std::ofstream{dir / "MANIFEST", ios_base::out | ios_base::binary | ios_base::app};
+        uint32_t length = 0xfffffff0;
+        uint64_t checksum = 0;
+        bytes_write(os, &length);
+        bytes_write(os, &checksum);
+    }
+    check(2 * max);
+    // Without manifest level directories are scanned, and a new manifest is written.
+    remove(dir / "MANIFEST");
+    check(2 * max);
+    ok = ok && exists(dir / "MANIFEST");
+    check(2 * max);
+    remove_all(dir);
+    return ok;
+}
+
+bool test_crash_recovery() {
+    auto dir = path{"crash_recovery_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.sync_files = true;
+    auto ok = true;
+    const long long max = 3000;
+    {
+        auto tree = LSMTree{dir, options};
+        for (long long i = 0; i < max; i++) {
+            tree.put(i, std::string(2000, 'c'));
+        }
+        ok = ok && exists(dir / "RUNNING");
+    }
+    ok = ok && !exists(dir / "RUNNING");
+    for (const auto &f:recursive_directory_iterator{dir}) {
+        ok = ok && f.path().extension() != ".tmp";
+    }
+    // Files a crash would leave: an sstable without manifest record and a partially written one.
+    auto sstable = *directory_iterator{dir / "0"};
+    copy_file(sstable.path(), dir / "0" / "100000.bin");
+    create_binary_ofstream(dir / "0" / "100001.bin.tmp") << "partial";
+    create_binary_ofstream(dir / "RUNNING");
+    {
+        auto tree = LSMTree{dir, options};
+        ok = ok && !exists(dir / "0" / "100000.bin") && !exists(dir / "0" / "100001.bin.tmp");
+        for (long long i = 0; i < max; i += 11) {
+            ok = ok && tree.get(i) == std::string(2000, 'c');
+        }
+    }
+    if (exists("/dev/full")) {
+        // A write failing for a full disk throws, instead of putting a short sstable in place.
+        auto data = SSTableData{{false, 1, 1, std::string(100000, 'f')}};
+        auto sstable = SSTable{};
+        sstable.fillData(data);
+        create_symlink("/dev/full", dir / "0" / "100002.bin.tmp");
+        try {
+            sstable.writeToDisk(dir / "0" / "100002.bin");
+            ok = false;
+        } catch (const SyncFailedException &) {
+        }
+        ok = ok && !exists(dir / "0" / "100002.bin");
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_warm_up() {
+    auto dir = path{"warm_up_test_data"};
+    remove_all(dir);
+    auto ok = true;
+    const long long max = 3000;
+    {
+        auto tree = LSMTree{dir};
+        for (long long i = 0; i < max; i++) {
+            tree.put(i, std::string(2000, 'w'));
+        }
+    }
+    {
+        auto cold = LSMTree{dir};
+        ok = ok && cold.memoryUsage().metadata == 0;
+    }
+    auto options = Options{};
+    options.warm_up_threads = 4;
+    size_t calls = 0, loaded = 0, total = 0;
+    options.warm_up_progress = [&calls, &loaded, &total](size_t l, size_t t) {
+        calls++;
+        loaded = l;
+        total = t;
+    };
+    {
+        auto tree = LSMTree{dir, options};
+        ok = ok && total > 0 && calls == total && loaded == total && tree.memoryUsage().metadata > 0;
+        for (long long i = 0; i < max; i += 13) {
+            ok = ok && tree.get(i) == std::string(2000, 'w');
+        }
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_open_files_limit() {
+    auto dir = path{"open_files_test_data"};
+    remove_all(dir);
+    auto ok = true;
+    const long long max = 20000;
+    auto options = Options{};
+    options.memtable_size = 16 << 10;
+    options.level0_limit = 1000; // Every flush stays an sstable of its own.
+    options.warm_up_threads = 2;
+    {
+        auto tree = LSMTree{dir, options};
+        for (long long i = 0; i < max; i++) {
+            tree.put(i, std::string(100, 'f'));
+        }
+    }
+    // Far fewer descriptors than sstables, idle ones are closed for others to be read.
+    auto limit = rlimit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    auto lowered = limit;
+    lowered.rlim_cur = 64;
+    setrlimit(RLIMIT_NOFILE, &lowered);
+    {
+        auto tree = LSMTree{dir, options};
+        for (long long i = 0; i < max; i += 7) {
+            ok = ok && tree.get(i) == std::string(100, 'f');
+        }
+    }
+    setrlimit(RLIMIT_NOFILE, &limit);
+    ok = ok && std::distance(directory_iterator{dir / "0"}, directory_iterator{}) > 64;
+    {
+        // With every cached descriptor in use, a newly opened one is still handed to its owner.
+        create_binary_ofstream(dir / "a") << "a";
+        create_binary_ofstream(dir / "b") << "b";
+        auto &cache = SSTableFileCache::instance();
+        auto owners = std::vector<uint64_t>{};
+        auto busy = std::vector<SSTableFileCache::Handle>{};
+        for (size_t i = 0; i < SSTABLE_MAX_OPEN_FILES; i++) {
+            owners.push_back(SSTableFileCache::newOwner());
+            busy.push_back(cache.open(owners.back(), dir / "a"));
+        }
+        owners.push_back(SSTableFileCache::newOwner());
+        auto handle = cache.open(owners.back(), dir / "b");
+        char c = 0;
+        ok = ok && ::pread(handle->fd, &c, 1, 0) == 1 && c == 'b';
+        busy.clear();
+        handle.reset();
+        for (auto owner:owners) {
+            cache.erase(owner);
+        }
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_memory_budget() {
+    auto dir = path{"memory_budget_test_data"};
+    remove_all(dir);
+    auto options = Options{};
+    options.memory_budget = 1024 * 1024;
+    options.row_cache_bytes = 4 * 1024 * 1024;
+    options.partitioned_metadata = true;
+    auto ok = true;
+    {
+        auto tree = LSMTree{dir, options};
+        const long long max = 4000; // About 4 MB, memtables are flushed at 512 KB instead of 2 MB.
+        for (long long i = 0; i < max; i++) {
+            tree.put(i, std::string(1000, 'a' + i % 26));
+            ok = ok && tree.memoryUsage().memtables <= options.memory_budget / 2 + 2000;
+        }
+        for (long long i = 0; i < max; i++) {
+            ok = ok && tree.get(i) == std::string(1000, 'a' + i % 26);
+        }
+        auto usage = tree.memoryUsage();
+        ok = ok && usage.block_cache > 0 && usage.row_cache > 0 && usage.total() <= options.memory_budget;
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_PartitionedKVStore_behavior() {
+    auto dir = std::string{"partitioned_test_data"};
+    remove_all(dir);
+    const uint64_t max = 120000; // Values below 100 bytes are not compressed, about 3 MB for every partition.
+    auto ok = true;
+    {
+        auto store = PartitionedKVStore{dir, 4};
+        auto writers = std::vector<std::thread>{};
+        for (uint64_t w = 0; w < 4; w++) {
+            writers.emplace_back([&store, w, max] {
+                for (uint64_t i = w; i < max; i += 4) {
+                    store.put(i, std::string(99, 'a' + i % 26));
+                }
+            });
+        }
+        for (auto &t:writers) {
+            t.join();
+        }
+        for (uint64_t i = 0; i < max; i += 2) {
+            ok = ok && store.del(i);
+        }
+    }
+    {
+        // Reopen, data persisted by every partition should be back.
+        auto store = PartitionedKVStore{dir, 4};
+        for (uint64_t i = 0; i < max; i++) {
+            ok = ok && store.get(i) == (i % 2 ? std::string(99, 'a' + i % 26) : "");
+        }
+        ok = ok && exists(path{dir} / "p3");
+    }
+    try {
+        auto store = PartitionedKVStore{dir, 2};
+        ok = false;
+    } catch (PartitionLayoutMismatchException &e) {
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_KVStore_async_write() {
+    auto dir = std::string{"async_test_data"};
+    remove_all(dir);
+    const uint64_t max = 40000;
+    auto ok = std::atomic<bool>{true};
+    {
+        auto store = KVStore{dir};
+        auto producers = std::vector<std::thread>{};
+        for (uint64_t p = 0; p < 4; p++) {
+            producers.emplace_back([&, p] {
+                auto puts = std::vector<std::future<bool>>{};
+                for (uint64_t i = p; i < max; i += 4) {
+                    puts.push_back(store.async_put(i, std::string(99, 'a' + i % 26)));
+                }
+                for (auto &f:puts) {
+                    f.get();
+                }
+                // Del issued after put by the same thread sees the put.
+                for (uint64_t i = p; i < max; i += 8) {
+                    if (!store.async_del(i).get()) {
+                        ok = false;
+                    }
+                }
+            });
+        }
+        for (auto &t:producers) {
+            t.join();
+        }
+        for (uint64_t i = 0; i < max; i++) {
+            if (store.get(i) != (i % 8 < 4 ? "" : std::string(99, 'a' + i % 26))) {
+                ok = false;
+            }
+        }
+    }
+    remove_all(dir);
+    return ok;
+}
+
+bool test_KVStore_async_get() {
+    auto dir = std::string{"async_get_test_data"};
+    remove_all(dir);
+    const uint64_t max = 40000;
+    auto ok = true;
+    {
+        auto store = KVStore{dir};
+        for (uint64_t i = 0; i < max; i++) {
+            store.put(i, std::string(99, 'a' + i % 26));
+        }
+        auto gets = std::vector<std::future<std::string>>{};
+        for (uint64_t i = 0; i < max; i += 7) {
+            gets.push_back(store.async_get(i));
+        }
+        for (uint64_t i = 0, j = 0; i < max; i += 7, j++) {
+            ok = ok && gets[j].get() == std::string(99, 'a' + i % 26);
+        }
+        auto keys = std::vector<uint64_t>{max + 1, 3, max - 1, 3};
+        auto values = store.async_multi_get(keys).get();
+        ok = ok && values.size() == keys.size() && values[0].empty() && values[1] == std::string(99, 'd') &&
+             values[2] == std::string(99, 'a' + (max - 1) % 26) && values[3] == values[1];
+        ok = ok && store.async_multi_get({}).get().empty();
+    }
+    remove_all(dir);
+    return ok;
+}
+
 template<typename... Datas>
 SSTableData merge(Datas... datas) {
     using DataIter=SSTableData::iterator;
@@ -353,6 +1563,32 @@ int main() {
     it("should correctly implement SSTable", test_SSTable_behavior);
     it("should correctly read/write bytes between SSTable in memory and disk.", test_SSTable_fileIO);
     it("should correctly implement DiskTableNode", test_DiskTableNode_behavior);
+    it("should find restart point by key", test_RestartIndex_floor);
+    it("should lookup through learned index", test_learned_index);
+    it("should load partitions of index and filter on demand", test_partitioned_metadata);
+    it("should serve gets from other threads during writes", test_LSMTree_concurrent_get);
+    it("should cache rows read from disk", test_LSMTree_row_cache);
+    it("should filter out keys absent from disk", test_key_filter);
+    it("should give upper levels more filter bits", test_filter_bits_per_level);
+    it("should compact one sstable at a time into next level", test_leveled_compaction);
+    it("should merge runs of similar size under tiered compaction", test_tiered_compaction);
+    it("should move sstables without overlap down as they are", test_trivial_move);
+    it("should drop tombstones in last level", test_tombstone_gc);
+    it("should delete key ranges with range tombstones", test_delete_range);
+    it("should fold merge operands into values", test_merge_operator);
+    it("should limit compaction I/O with priority for flushes", test_rate_limiter);
+    it("should size levels by bytes of last level", test_dynamic_level_bytes);
+    it("should build xor filter of sstable keys", test_xor_filter);
+    it("should tell ranges without keys", test_range_filter);
+    it("should scan keys in range", test_LSMTree_scan);
+    it("should keep memory within budget", test_memory_budget);
+    it("should restore sstables from manifest", test_manifest);
+    it("should load sstable metadata when opening", test_warm_up);
+    it("should read sstables with fewer descriptors than sstables", test_open_files_limit);
+    it("should remove files left by a crash", test_crash_recovery);
+    it("should route keys to partitions", test_PartitionedKVStore_behavior);
+    it("should apply writes queued from many threads", test_KVStore_async_write);
+    it("should serve gets from reader threads", test_KVStore_async_get);
     it("should merge data correctly", test_SSTableData_merge);
     it("should correctly erase data in vector", test_vector_erase);
     it("should read sstable correctly", test_SSTable_input);
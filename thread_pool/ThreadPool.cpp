@@ -0,0 +1,50 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back([this] { run(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{jobs_mutex};
+        stopping = true;
+    }
+    jobs_cv.notify_all();
+    for (auto &w:workers) {
+        w.join();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return workers.size();
+}
+
+void ThreadPool::enqueue(std::function<void()> &&job) {
+    {
+        std::lock_guard lock{jobs_mutex};
+        jobs.push(std::move(job));
+    }
+    jobs_cv.notify_one();
+}
+
+void ThreadPool::run() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock{jobs_mutex};
+            jobs_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop();
+        }
+        job();
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef LSMTREE_THREADPOOL_H
+#define LSMTREE_THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+/*
+ * Fixed number of worker threads running submitted jobs in FIFO order.
+ * Jobs still queued when pool is destroyed are run before workers exit.
+ */
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    bool stopping{false};
+
+    void run();
+
+    void enqueue(std::function<void()> &&job);
+
+public:
+    explicit ThreadPool(size_t threads);
+
+    ~ThreadPool();
+
+    size_t size() const;
+
+    template<typename F>
+    auto submit(F &&f) -> std::future<decltype(f())> {
+        using R = decltype(f());
+        // std::function requires a copyable callable, packaged_task is move only.
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        auto result = task->get_future();
+        enqueue([task] { (*task)(); });
+        return result;
+    }
+};
+
+
+#endif //LSMTREE_THREADPOOL_H